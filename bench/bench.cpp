@@ -0,0 +1,746 @@
+/*******************************************************************************
+ * 文件名称: bench
+ * 项目名称: TEFModLoader
+ * 创建时间: 2026/10/16
+ * 作者: EternalFuture゙
+ * Github: https://github.com/eternalfuture-e38299
+ * 版权声明: Copyright © 2025 EternalFuture゙
+ * 
+ * MIT License
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "vmasm/compiler.hpp"
+#include "vmasm/executor.hpp"
+#include "vmasm/profiler.hpp"
+#include "vmasm/syscalls.hpp"
+#include "vmasm/vm.hpp"
+
+namespace {
+    // 全部堆分配次数, 用于统计每次执行的分配数
+    std::atomic<uint64_t> allocation_count{0};
+}
+
+void *operator new(const std::size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+    std::free(p);
+}
+
+namespace {
+
+    // 编译并执行 runs 次, 返回最快一次的耗时 (纳秒), 以减少噪声; 解码与加载期优化不计入耗时
+    double TimeExecute(const std::string& source, const std::function<void(VMAsm::VirtualMachine&)>& setup,
+                       const int runs = 3) {
+        double best = 0;
+        for (int i = 0; i < runs; ++i) {
+            VMAsm::VirtualMachine vm;
+            setup(vm);
+            VMAsm::Compiler().CompileString(source, &vm);
+            vm.Prepare();
+
+            const auto begin = std::chrono::steady_clock::now();
+            vm.Execute();
+            const auto end = std::chrono::steady_clock::now();
+
+            const double ns = std::chrono::duration<double, std::nano>(end - begin).count();
+            if (i == 0 || ns < best) best = ns;
+        }
+        return best;
+    }
+
+    // 典型的算术循环: 每次迭代执行 add, add, sub, jnz 共 4 条指令
+    std::string MakeArithmeticLoop(const long iterations) {
+        std::ostringstream src;
+        src << "main:\n"
+            << "    mov " << iterations << ", R1\n"
+            << "    mov 0, R2\n"
+            << "loop:\n"
+            << "    add R2, R1, R2\n"
+            << "    add R3, 3, R3\n"
+            << "    sub R1, 1, R1\n"
+            << "    jnz R1, #loop\n"
+            << "    halt\n";
+        return src.str();
+    }
+
+    // 处理函数极短的循环: 每次迭代执行 mov, mov, sub, jnz 共 4 条指令, 开销主要来自分派
+    std::string MakeMoveLoop(const long iterations) {
+        std::ostringstream src;
+        src << "main:\n"
+            << "    mov " << iterations << ", R1\n"
+            << "loop:\n"
+            << "    mov R1, R2\n"
+            << "    mov R2, R3\n"
+            << "    sub R1, 1, R1\n"
+            << "    jnz R1, #loop\n"
+            << "    halt\n";
+        return src.str();
+    }
+
+    // 生成一个总长度约为 size 的程序: 循环体位于程序末尾,
+    // 每次迭代都会跳回到远端的 loop 标签, 用于衡量跳转开销是否与程序大小相关
+    std::string MakeFarJumpProgram(const size_t size, const long iterations) {
+        std::ostringstream src;
+        src << "main:\n"
+            << "    mov " << iterations << ", R1\n"
+            << "    jmp #loop\n";
+        for (size_t i = 0; i + 5 < size; ++i) src << "    nop\n";
+        src << "loop:\n"
+            << "    sub R1, 1, R1\n"
+            << "    jnz R1, #loop\n"
+            << "    halt\n";
+        return src.str();
+    }
+
+    void BenchDispatch() {
+        constexpr long iterations = 5000000;
+        constexpr long instructions_per_iteration = 4;
+        constexpr double instructions = iterations * instructions_per_iteration;
+
+        const std::pair<const char*, std::string> workloads[] = {
+            {"arithmetic loop", MakeArithmeticLoop(iterations)},
+            {"mov loop", MakeMoveLoop(iterations)},
+        };
+
+        std::cout << "dispatch (ns/instruction)\n";
+        std::cout << std::setw(18) << "workload" << std::setw(12) << "switch" << std::setw(12) << "threaded" << "\n";
+
+        for (const auto& [name, source] : workloads) {
+            const double switch_ns = TimeExecute(source, [](VMAsm::VirtualMachine& vm) {
+                vm.SetDispatchMode(VMAsm::DispatchMode::Switch);
+            });
+            const double threaded_ns = TimeExecute(source, [](VMAsm::VirtualMachine& vm) {
+                vm.SetDispatchMode(VMAsm::DispatchMode::Threaded);
+            });
+            std::cout << std::setw(18) << name << std::fixed << std::setprecision(2)
+                      << std::setw(12) << switch_ns / instructions
+                      << std::setw(12) << threaded_ns / instructions << "\n";
+        }
+    }
+
+    void BenchFusion() {
+        constexpr long iterations = 5000000;
+        constexpr long instructions_per_iteration = 4;
+        constexpr double instructions = iterations * instructions_per_iteration;
+        const std::string source = MakeArithmeticLoop(iterations);
+
+        const double plain_ns = TimeExecute(source, [](VMAsm::VirtualMachine& vm) { vm.SetFusionEnabled(false); });
+        const double fused_ns = TimeExecute(source, [](VMAsm::VirtualMachine& vm) { vm.SetFusionEnabled(true); });
+
+        std::cout << "superinstructions (arithmetic loop, ns/instruction)\n";
+        std::cout << std::fixed << std::setprecision(2)
+                  << std::setw(18) << "unfused" << std::setw(12) << plain_ns / instructions << "\n"
+                  << std::setw(18) << "fused" << std::setw(12) << fused_ns / instructions << "\n";
+
+        VMAsm::VirtualMachine vm;
+        VMAsm::Compiler().CompileString(source, &vm);
+        vm.Prepare();
+        for (const auto& [pattern, sites, saved] : vm.GetFusionStats()) {
+            std::cout << std::setw(18) << pattern << std::setw(12) << sites << " site(s), "
+                      << saved << " dispatch(es) saved per execution\n";
+        }
+    }
+
+    // 循环体中带有可在编译期求值的常量运算与条件跳转, 以及生成代码中常见的死存储与不可达代码
+    std::string MakeConstantLoop(const long iterations) {
+        std::ostringstream src;
+        src << "main:\n"
+            << "    mov " << iterations << ", R1\n"
+            << "loop:\n"
+            << "    mov 4, R2\n"
+            << "    mov 6, R3\n"
+            << "    add R2, R3, R4\n"
+            << "    sub R4, 1, R5\n"
+            << "    neg R5, R6\n"
+            << "    mov 0, R8\n"
+            << "    jg R6, #next\n"
+            << "    jl R6, #body\n"
+            << "    add R7, 1, R7\n"
+            << "    mov 1, R9\n"
+            << "body:\n"
+            << "    add R6, R1, R7\n"
+            << "next:\n"
+            << "    mov R1, R8\n"
+            << "    sub R1, 1, R1\n"
+            << "    jnz R1, #loop\n"
+            << "    halt\n";
+        return src.str();
+    }
+
+    // 代码生成器常见的跳转链与越过无条件跳转的条件分支
+    std::string MakeJumpChains(const long iterations) {
+        std::ostringstream src;
+        src << "main:\n"
+            << "    mov " << iterations << ", R1\n"
+            << "loop:\n"
+            << "    add R2, 1, R2\n"
+            << "    jmp #step1\n"
+            << "step1:\n"
+            << "    jmp #step2\n"
+            << "step2:\n"
+            << "    sub R1, 1, R1\n"
+            << "    jz R1, #more\n"
+            << "    jmp #again\n"
+            << "more:\n"
+            << "    add R3, 1, R3\n"
+            << "    jmp #done\n"
+            << "again:\n"
+            << "    jmp #loop\n"
+            << "done:\n"
+            << "    halt\n";
+        return src.str();
+    }
+
+    void BenchOptimizerLevels(const char* name, const std::string& source) {
+        std::cout << "optimizer (" << name << ")\n"
+                  << std::setw(18) << "level" << std::setw(8) << "size" << std::setw(14) << "instructions"
+                  << std::setw(12) << "ms" << "\n";
+        for (const int level : {VMAsm::OptimizeNone, VMAsm::OptimizeConstants, VMAsm::OptimizeDeadCode}) {
+            VMAsm::Compiler compiler;
+            compiler.SetOptimizationLevel(level);
+            const auto program = compiler.CompileString(source);
+
+            double best = 0;
+            uint64_t retired = 0;
+            for (int run = 0; run < 3; ++run) {
+                VMAsm::VirtualMachine vm;
+                vm.Attach(program);
+                const auto begin = std::chrono::steady_clock::now();
+                vm.Execute();
+                const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+                if (run == 0 || ns < best) best = ns;
+                retired = vm.GetInstructionCount();
+            }
+            std::cout << std::setw(18) << ("-O" + std::to_string(level)) << std::setw(8) << program->Size()
+                      << std::setw(14) << retired
+                      << std::fixed << std::setprecision(2) << std::setw(12) << best / 1e6 << "\n";
+        }
+    }
+
+    void BenchOptimizer() {
+        const std::pair<const char*, std::string> workloads[] = {
+            {"constant loop", MakeConstantLoop(2000000)},
+            {"jump chains", MakeJumpChains(2000000)},
+        };
+
+        for (const auto& [name, source] : workloads) {
+            BenchOptimizerLevels(name, source);
+        }
+    }
+
+    void BenchJit() {
+        constexpr long iterations = 5000000;
+        constexpr long instructions_per_iteration = 4;
+        constexpr double instructions = iterations * instructions_per_iteration;
+
+        const std::pair<const char*, std::string> workloads[] = {
+            {"arithmetic loop", MakeArithmeticLoop(iterations)},
+            {"mov loop", MakeMoveLoop(iterations)},
+        };
+
+        std::cout << "jit (ns/instruction)\n";
+        if (!VMAsm::JitCompiler::IsSupported()) {
+            std::cout << std::setw(18) << "unsupported on this platform\n";
+            return;
+        }
+        std::cout << std::setw(18) << "workload" << std::setw(12) << "interpret" << std::setw(12) << "jit" << "\n";
+
+        for (const auto& [name, source] : workloads) {
+            const double interpret_ns = TimeExecute(source, [](VMAsm::VirtualMachine&) {});
+            const double jit_ns = TimeExecute(source, [](VMAsm::VirtualMachine& vm) { vm.SetJitEnabled(true); });
+            std::cout << std::setw(18) << name << std::fixed << std::setprecision(2)
+                      << std::setw(12) << interpret_ns / instructions
+                      << std::setw(12) << jit_ns / instructions << "\n";
+        }
+    }
+
+    // 每次迭代保存、交换并清空一次快照, 寄存器中持有超长字符串
+    void BenchSnapshots() {
+        constexpr long iterations = 2000000;
+        std::ostringstream src;
+        src << "main:\n"
+            << "    mov \"a register value longer than eight bytes\", R2\n"
+            << "    mov " << iterations << ", R1\n"
+            << "loop:\n"
+            << "    snap_save\n"
+            << "    snap_swap\n"
+            << "    snap_push\n"
+            << "    snap_pop\n"
+            << "    snap_clear\n"
+            << "    sub R1, 1, R1\n"
+            << "    jnz R1, #loop\n"
+            << "    halt\n";
+
+        const double ns = TimeExecute(src.str(), [](VMAsm::VirtualMachine&) {});
+        std::cout << "snapshots (save+swap+push+pop+clear, one register write per iteration)\n"
+                  << std::setw(18) << "ns/iteration" << std::setw(12) << std::fixed << std::setprecision(2)
+                  << ns / iterations << "\n";
+    }
+
+    // 每次迭代执行一次带四个参数 (含一个长字符串寄存器) 的空系统调用, 观察参数传递与分派的开销
+    void NoopSyscall(VMAsm::VirtualMachine *, const VMAsm::SyscallArgs &) {}
+
+    long TypedSyscall(const long counter, const std::string_view text, const std::string_view format, const long value) {
+        return counter + static_cast<long>(text.size() + format.size()) + value;
+    }
+
+    void BenchSyscalls() {
+        constexpr long iterations = 2000000;
+        std::ostringstream src;
+        src << "main:\n"
+            << "    mov \"a register value longer than eight bytes\", R2\n"
+            << "    mov " << iterations << ", R1\n"
+            << "loop:\n"
+            << "    sys 20, R1, R2, \"iteration %d: %s\", 42\n"
+            << "    sub R1, 1, R1\n"
+            << "    jnz R1, #loop\n"
+            << "    halt\n";
+
+        long calls = 0;
+        const double function_ns = TimeExecute(src.str(), [](VMAsm::VirtualMachine &vm) {
+            vm.RegisterSyscall(20, NoopSyscall);
+        });
+        const double typed_ns = TimeExecute(src.str(), [](VMAsm::VirtualMachine &vm) {
+            vm.RegisterSyscall<&TypedSyscall>(20);
+        });
+        const double method_ns = TimeExecute(src.str(), [&calls](VMAsm::VirtualMachine &vm) {
+            vm.RegisterSyscall(20, [&calls](VMAsm::VirtualMachine *, const VMAsm::SyscallArgs &args) { calls += static_cast<long>(args.size()); });
+        });
+
+        std::cout << "syscalls (4 arguments, one call per iteration)\n"
+                  << std::setw(18) << "function" << std::setw(12) << std::fixed << std::setprecision(2)
+                  << function_ns / iterations << " ns/iteration\n"
+                  << std::setw(18) << "typed" << std::setw(12) << typed_ns / iterations << " ns/iteration\n"
+                  << std::setw(18) << "closure" << std::setw(12) << method_ns / iterations << " ns/iteration\n";
+    }
+
+    // 每次迭代格式化输出一行, 输出函数只统计字节数, 比较缓冲与逐行写出
+    void BenchPrint() {
+        constexpr long iterations = 500000;
+        std::ostringstream src;
+        src << "main:\n"
+            << "    mov " << iterations << ", R1\n"
+            << "loop:\n"
+            << "    sys 1, \"line %d of %s\\n\", R1, \"output\"\n"
+            << "    sub R1, 1, R1\n"
+            << "    jnz R1, #loop\n"
+            << "    halt\n";
+
+        size_t bytes = 0;
+        size_t writes = 0;
+        auto setup = [&bytes, &writes](const size_t buffer) {
+            return [&bytes, &writes, buffer](VMAsm::VirtualMachine &vm) {
+                VMAsm::SysCallRegistry::Init(&vm);
+                vm.SetOutput([&bytes, &writes](const std::string_view text) { bytes += text.size(); ++writes; }, buffer);
+            };
+        };
+
+        std::cout << "print (" << iterations << " formatted lines)\n"
+                  << std::setw(18) << "buffer" << std::setw(16) << "ns/line" << std::setw(12) << "writes" << "\n";
+        for (const size_t buffer : {size_t{0}, VMAsm::DefaultOutputBuffer}) {
+            writes = 0;
+            const double ns = TimeExecute(src.str(), setup(buffer), 1);
+            std::cout << std::setw(18) << buffer << std::setw(16) << std::fixed << std::setprecision(2)
+                      << ns / iterations << std::setw(12) << writes << "\n";
+        }
+    }
+
+    // 采样剖析按默认间隔分段执行, 与直接执行比较; 数值越接近 0% 越好
+    void BenchSampling() {
+        constexpr long iterations = 5000000;
+        const std::string source = MakeArithmeticLoop(iterations);
+
+        auto time = [&source](const bool jit, const bool sample) {
+            double best = 0;
+            for (int i = 0; i < 5; ++i) {
+                VMAsm::VirtualMachine vm;
+                VMAsm::Compiler().CompileString(source, &vm);
+                vm.SetJitEnabled(jit);
+                vm.Prepare();
+                VMAsm::SamplingProfiler profiler;
+
+                const auto begin = std::chrono::steady_clock::now();
+                if (sample) profiler.Execute(vm);
+                else vm.Execute();
+                const auto end = std::chrono::steady_clock::now();
+
+                const double ns = std::chrono::duration<double, std::nano>(end - begin).count();
+                if (i == 0 || ns < best) best = ns;
+            }
+            return best;
+        };
+
+        std::cout << "sampling profiler (interval " << VMAsm::DefaultSampleInterval << " instructions)\n"
+                  << std::setw(18) << "mode" << std::setw(12) << "plain ms" << std::setw(12) << "sampled ms"
+                  << std::setw(12) << "overhead" << "\n";
+        for (const bool jit : {false, true}) {
+            if (jit && !VMAsm::JitCompiler::IsSupported()) continue;
+            const double plain = time(jit, false);
+            const double sampled = time(jit, true);
+            std::cout << std::setw(18) << (jit ? "jit" : "interpret") << std::fixed << std::setprecision(2)
+                      << std::setw(12) << plain / 1e6 << std::setw(12) << sampled / 1e6
+                      << std::setw(11) << (sampled / plain - 1) * 100 << "%\n";
+        }
+    }
+
+    // 同一程序的多个实例在执行器上并行运行, 观察吞吐随线程数的变化
+    void BenchExecutor() {
+        constexpr size_t job_count = 256;
+        const auto program = VMAsm::Compiler().CompileString(MakeArithmeticLoop(100000));
+        const std::vector<VMAsm::Job> jobs(job_count, VMAsm::Job{program});
+
+        const size_t hardware = std::max(1u, std::thread::hardware_concurrency());
+        std::cout << "executor (" << job_count << " jobs, " << hardware << " hardware thread(s))\n";
+        std::cout << std::setw(12) << "threads" << std::setw(14) << "jobs/s" << std::setw(16) << "Minstr/s" << "\n";
+
+        for (size_t threads = 1; threads <= hardware; threads *= 2) {
+            VMAsm::Executor executor(threads);
+            executor.Run(jobs);
+            const auto &stats = executor.GetStats();
+            std::cout << std::setw(12) << threads << std::fixed << std::setprecision(0)
+                      << std::setw(14) << stats.JobsPerSecond()
+                      << std::setw(16) << stats.InstructionsPerSecond() / 1e6 << "\n";
+        }
+    }
+
+    void BenchJumpScaling() {
+        constexpr long iterations = 2000000;
+
+        std::cout << "jump scaling (" << iterations << " taken branches per run)\n";
+        std::cout << std::setw(12) << "program" << std::setw(16) << "ns/iteration" << "\n";
+
+        for (size_t size = 1000; size <= 1000000; size *= 10) {
+            VMAsm::VirtualMachine vm;
+            VMAsm::Compiler().CompileString(MakeFarJumpProgram(size, iterations), &vm);
+            vm.Prepare();
+
+            const auto begin = std::chrono::steady_clock::now();
+            vm.Execute();
+            const auto end = std::chrono::steady_clock::now();
+
+            const double ns = std::chrono::duration<double, std::nano>(end - begin).count();
+            std::cout << std::setw(12) << size
+                      << std::setw(16) << std::fixed << std::setprecision(2) << ns / iterations << "\n";
+        }
+    }
+
+    // 生成器输出风格的大源文件: 标签、注释、字符串、字节数组与各类操作数混合
+    std::string MakeCompileSource(const size_t blocks) {
+        std::ostringstream src;
+        src << "#table main\n"
+            << "main:\n";
+        for (size_t i = 0; i < blocks; ++i) {
+            src << "block_" << i << ":\n"
+                << "    mov " << i * 7919 << ", R3        // seed\n"
+                << "    add R1, R2, R3\n"
+                << "    sub R3, 1, R3\n"
+                << "    mov \"block " << i << ", value\", R5\n"
+                << "    sys 1, \"%s: %d\\n\", R5, R3\n"
+                << "    mov [0x01, 0x02, 0x03], R4\n"
+                << "    mov 2.5, R6\n"
+                << "    jnz R3, #block_" << i << "\n";
+        }
+        src << "    halt\n";
+        return src.str();
+    }
+
+    void BenchCompile() {
+        const std::string source = MakeCompileSource(100000);
+
+        double best = 0;
+        for (int run = 0; run < 3; ++run) {
+            const auto begin = std::chrono::steady_clock::now();
+            VMAsm::Compiler().CompileString(source);
+            const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+            if (run == 0 || ns < best) best = ns;
+        }
+
+        const double megabytes = static_cast<double>(source.size()) / (1024 * 1024);
+        std::cout << "compile (" << std::fixed << std::setprecision(1) << megabytes << " MB source)\n"
+                  << std::setw(18) << "ms" << std::setw(12) << std::setprecision(2) << best / 1e6 << "\n"
+                  << std::setw(18) << "MB/s" << std::setw(12) << megabytes / (best / 1e9) << "\n";
+    }
+}
+
+namespace {
+    // 斐波那契: 每轮在寄存器中迭代计算 fib(90), 结果不超过 long 的范围
+    std::string MakeFibonacci(const long rounds) {
+        std::ostringstream src;
+        src << "main:\n"
+            << "    mov " << rounds << ", R1\n"
+            << "round:\n"
+            << "    mov 0, R2\n"
+            << "    mov 1, R3\n"
+            << "    mov 90, R5\n"
+            << "step:\n"
+            << "    add R2, R3, R4\n"
+            << "    mov R3, R2\n"
+            << "    mov R4, R3\n"
+            << "    sub R5, 1, R5\n"
+            << "    jnz R5, #step\n"
+            << "    sub R1, 1, R1\n"
+            << "    jnz R1, #round\n"
+            << "    halt\n";
+        return src.str();
+    }
+
+    // 分支密集的状态机: 四个状态轮转, 每步经过多次条件跳转
+    std::string MakeStateMachine(const long steps) {
+        std::ostringstream src;
+        src << "main:\n"
+            << "    mov " << steps << ", R1\n"
+            << "    mov 0, R5\n"
+            << "loop:\n"
+            << "    jz R5, #s0\n"
+            << "    sub R5, 1, R6\n"
+            << "    jz R6, #s1\n"
+            << "    sub R5, 2, R6\n"
+            << "    jz R6, #s2\n"
+            << "    mov 0, R5\n"
+            << "    jmp #next\n"
+            << "s0:\n"
+            << "    add R7, 1, R7\n"
+            << "    mov 1, R5\n"
+            << "    jmp #next\n"
+            << "s1:\n"
+            << "    add R8, 1, R8\n"
+            << "    mov 2, R5\n"
+            << "    jmp #next\n"
+            << "s2:\n"
+            << "    add R9, 1, R9\n"
+            << "    mov 3, R5\n"
+            << "next:\n"
+            << "    sub R1, 1, R1\n"
+            << "    jnz R1, #loop\n"
+            << "    halt\n";
+        return src.str();
+    }
+
+    // 快照密集: 每次迭代保存、交换、压栈、弹栈并写入寄存器
+    std::string MakeSnapshotLoop(const long iterations) {
+        std::ostringstream src;
+        src << "main:\n"
+            << "    mov \"a register value longer than eight bytes\", R2\n"
+            << "    mov " << iterations << ", R1\n"
+            << "loop:\n"
+            << "    snap_save\n"
+            << "    snap_push\n"
+            << "    add R3, 1, R3\n"
+            << "    snap_pop\n"
+            << "    snap_swap\n"
+            << "    snap_swap\n"
+            << "    sub R1, 1, R1\n"
+            << "    jnz R1, #loop\n"
+            << "    halt\n";
+        return src.str();
+    }
+
+    // 系统调用密集: 每次迭代格式化输出一行, 输出函数丢弃内容
+    std::string MakePrintLoop(const long iterations) {
+        std::ostringstream src;
+        src << "main:\n"
+            << "    mov \"worker\", R2\n"
+            << "    mov " << iterations << ", R1\n"
+            << "loop:\n"
+            << "    sys 1, \"%s: step %d, value %x\\n\", R2, R1, R1\n"
+            << "    sub R1, 1, R1\n"
+            << "    jnz R1, #loop\n"
+            << "    halt\n";
+        return src.str();
+    }
+
+    // 大程序: 约 blocks * 3 条直线代码组成的循环体, 衡量大映像下的取指与缓存压力
+    std::string MakeLargeProgram(const size_t blocks, const long rounds) {
+        std::ostringstream src;
+        src << "main:\n"
+            << "    mov " << rounds << ", R1\n"
+            << "body:\n";
+        for (size_t i = 0; i < blocks; ++i) {
+            const size_t reg = 2 + i % 12;
+            src << "    add R" << reg << ", " << i % 7 + 1 << ", R" << reg << "\n"
+                << "    mov R" << reg << ", R15\n"
+                << "    sub R15, R" << 2 + (i + 5) % 12 << ", R14\n";
+        }
+        src << "    sub R1, 1, R1\n"
+            << "    jnz R1, #body\n"
+            << "    halt\n";
+        return src.str();
+    }
+
+    struct WorkloadResult {
+        std::string workload{};
+        std::string mode{};
+        uint64_t instructions{};
+        double ns{};
+        uint64_t allocations{};
+    };
+
+    // 每个工作负载分别以解释器与 JIT 执行, 取最快一次; 分配数为该次执行期间的堆分配次数.
+    // only 非空时只运行同名的工作负载
+    std::vector<WorkloadResult> RunSuite(const std::string &only) {
+        const std::pair<const char *, std::string> workloads[] = {
+            {"counting", MakeArithmeticLoop(2000000)},
+            {"fibonacci", MakeFibonacci(20000)},
+            {"state_machine", MakeStateMachine(1000000)},
+            {"snapshots", MakeSnapshotLoop(500000)},
+            {"print", MakePrintLoop(200000)},
+            {"large_program", MakeLargeProgram(50000, 20)},
+        };
+
+        std::vector<WorkloadResult> results;
+        for (const auto &[name, source] : workloads) {
+            if (!only.empty() && only != name) continue;
+            for (const bool jit : {false, true}) {
+                if (jit && !VMAsm::JitCompiler::IsSupported()) continue;
+
+                WorkloadResult best{name, jit ? "jit" : "interpreter"};
+                for (int run = 0; run < 3; ++run) {
+                    VMAsm::VirtualMachine vm;
+                    VMAsm::SysCallRegistry::Init(&vm);
+                    vm.SetOutput([](std::string_view) {});
+                    vm.SetJitEnabled(jit);
+                    VMAsm::Compiler().CompileString(source, &vm);
+                    vm.Prepare();
+
+                    const uint64_t allocations = allocation_count.load(std::memory_order_relaxed);
+                    const auto begin = std::chrono::steady_clock::now();
+                    vm.Execute();
+                    const auto end = std::chrono::steady_clock::now();
+
+                    const double ns = std::chrono::duration<double, std::nano>(end - begin).count();
+                    if (run == 0 || ns < best.ns) {
+                        best.ns = ns;
+                        best.instructions = vm.GetInstructionCount();
+                        best.allocations = allocation_count.load(std::memory_order_relaxed) - allocations;
+                    }
+                }
+                results.push_back(best);
+            }
+        }
+        return results;
+    }
+
+    void PrintSuite(const std::vector<WorkloadResult> &results) {
+        std::cout << "workload suite\n"
+                  << std::setw(16) << "workload" << std::setw(13) << "mode" << std::setw(14) << "instructions"
+                  << std::setw(10) << "ns/instr" << std::setw(12) << "Minstr/s" << std::setw(8) << "allocs" << "\n";
+        for (const WorkloadResult &result : results) {
+            const double per_instruction = result.ns / static_cast<double>(result.instructions);
+            std::cout << std::setw(16) << result.workload << std::setw(13) << result.mode
+                      << std::setw(14) << result.instructions << std::fixed << std::setprecision(2)
+                      << std::setw(10) << per_instruction << std::setprecision(0)
+                      << std::setw(12) << 1e3 / per_instruction << std::setw(8) << result.allocations << "\n";
+        }
+    }
+
+    // 每个结果一个对象, 字段名稳定, 便于脚本对比不同提交之间的变化
+    void WriteJson(const std::vector<WorkloadResult> &results, std::ostream &out) {
+        out << "{\n  \"results\": [\n";
+        for (size_t i = 0; i < results.size(); ++i) {
+            const WorkloadResult &result = results[i];
+            const double per_instruction = result.ns / static_cast<double>(result.instructions);
+            out << "    {\"workload\": \"" << result.workload << "\", \"mode\": \"" << result.mode << "\""
+                << ", \"instructions\": " << result.instructions
+                << std::fixed << std::setprecision(0) << ", \"ns\": " << result.ns
+                << std::setprecision(4) << ", \"ns_per_instruction\": " << per_instruction
+                << std::setprecision(0) << ", \"instructions_per_second\": " << 1e9 / per_instruction
+                << ", \"allocations\": " << result.allocations << "}"
+                << (i + 1 < results.size() ? "," : "") << "\n";
+        }
+        out << "  ]\n}\n";
+    }
+}
+
+// 用法: vmasm_bench [--suite] [--workload <name>] [--json <file>]
+//   --suite            只运行工作负载套件
+//   --workload <name>  套件中只运行指定的工作负载
+//   --json <file>      把套件结果以 JSON 写入文件, "-" 表示标准输出
+int main(const int argc, char *argv[]) {
+    bool suite_only = false;
+    std::string workload;
+    std::string json;
+    for (int i = 1; i < argc; ++i) {
+        if (const std::string arg = argv[i]; arg == "--suite") {
+            suite_only = true;
+        } else if (arg == "--workload" && i + 1 < argc) {
+            workload = argv[++i];
+        } else if (arg == "--json" && i + 1 < argc) {
+            json = argv[++i];
+        } else {
+            std::cerr << "usage: vmasm_bench [--suite] [--workload <name>] [--json <file>]\n";
+            return 1;
+        }
+    }
+
+    const std::vector<WorkloadResult> results = RunSuite(workload);
+    if (results.empty()) {
+        std::cerr << "unknown workload " << workload << "\n";
+        return 1;
+    }
+    if (json != "-") PrintSuite(results);
+    if (json == "-") {
+        WriteJson(results, std::cout);
+    } else if (!json.empty()) {
+        std::ofstream out(json);
+        if (!out) {
+            std::cerr << "cannot write " << json << "\n";
+            return 1;
+        }
+        WriteJson(results, out);
+    }
+    if (suite_only) return 0;
+
+    BenchDispatch();
+    BenchFusion();
+    BenchOptimizer();
+    BenchJit();
+    BenchSnapshots();
+    BenchSyscalls();
+    BenchPrint();
+    BenchSampling();
+    BenchExecutor();
+    BenchJumpScaling();
+    BenchCompile();
+    return 0;
+}
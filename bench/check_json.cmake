@@ -0,0 +1,40 @@
+# 冒烟测试: 运行一个工作负载, 检查 --json 的输出可以解析且各字段合理
+# 用法: cmake -DBENCH=<vmasm_bench> -P check_json.cmake
+
+execute_process(
+        COMMAND ${BENCH} --suite --workload fibonacci --json -
+        OUTPUT_VARIABLE output
+        RESULT_VARIABLE result
+)
+if (NOT result EQUAL 0)
+    message(FATAL_ERROR "vmasm_bench exited with ${result}")
+endif ()
+
+string(JSON count ERROR_VARIABLE error LENGTH "${output}" results)
+if (error)
+    message(FATAL_ERROR "invalid JSON: ${error}\n${output}")
+endif ()
+if (count EQUAL 0)
+    message(FATAL_ERROR "no results\n${output}")
+endif ()
+
+math(EXPR last "${count} - 1")
+foreach (i RANGE ${last})
+    string(JSON workload GET "${output}" results ${i} workload)
+    string(JSON mode GET "${output}" results ${i} mode)
+    string(JSON instructions GET "${output}" results ${i} instructions)
+    string(JSON ns GET "${output}" results ${i} ns)
+    string(JSON allocations GET "${output}" results ${i} allocations)
+
+    if (NOT workload STREQUAL "fibonacci" OR NOT mode MATCHES "^(interpreter|jit)$")
+        message(FATAL_ERROR "unexpected result ${workload}/${mode}")
+    endif ()
+    if (NOT instructions GREATER 0 OR NOT ns GREATER 0)
+        message(FATAL_ERROR "${mode}: instructions=${instructions} ns=${ns}")
+    endif ()
+    # 分配只来自首次写入时复制寄存器文件与 JIT 编译, 不能随执行的指令数增长
+    math(EXPR limit "${instructions} / 10000")
+    if (allocations GREATER limit)
+        message(FATAL_ERROR "${mode}: ${allocations} allocations for ${instructions} instructions")
+    endif ()
+endforeach ()
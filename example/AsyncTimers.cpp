@@ -0,0 +1,205 @@
+/*******************************************************************************
+ * 文件名称: AsyncTimers
+ * 项目名称: TEFModLoader
+ * 创建时间: 2026/10/16
+ * 作者: EternalFuture゙
+ * Github: https://github.com/eternalfuture-e38299
+ * 版权声明: Copyright © 2025 EternalFuture゙
+ * 
+ * MIT License
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+
+// 异步系统调用示例: 单线程事件循环驱动大量虚拟机.
+// sys 10 请求休眠若干毫秒, 处理函数只登记到期时间并挂起虚拟机,
+// 事件循环通过 timerfd + epoll 等待最早的到期时间, 到期后恢复对应的虚拟机
+
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "vmasm/compiler.hpp"
+#include "vmasm/syscalls.hpp"
+#include "vmasm/vm.hpp"
+
+namespace {
+
+    constexpr int SysSleep = 10;
+
+    // 每个虚拟机休眠 R1 次, 每次 R3 毫秒, R2 记录完成的次数
+    const char *Source = R"(
+main:
+    mov 0, R2
+    mov 5, R1
+loop:
+    sys 10, R3
+    add R2, 1, R2
+    sub R1, 1, R1
+    jnz R1, #loop
+    halt
+)";
+
+    using Clock = std::chrono::steady_clock;
+
+    struct Timer {
+        Clock::time_point deadline;
+        VMAsm::VirtualMachine *vm;
+
+        bool operator>(const Timer &other) const { return deadline > other.deadline; }
+    };
+
+    class EventLoop {
+        public:
+            EventLoop() {
+                _epoll = epoll_create1(0);
+                _timer = timerfd_create(CLOCK_MONOTONIC, 0);
+                if (_epoll < 0 || _timer < 0) throw std::runtime_error("unable to create epoll/timerfd");
+
+                epoll_event event{};
+                event.events = EPOLLIN;
+                event.data.fd = _timer;
+                epoll_ctl(_epoll, EPOLL_CTL_ADD, _timer, &event);
+            }
+
+            ~EventLoop() {
+                close(_timer);
+                close(_epoll);
+            }
+
+            // sys 10 的处理函数: 登记到期时间后挂起, 不阻塞线程
+            void Sleep(VMAsm::VirtualMachine *vm, const VMAsm::SyscallArgs &args) {
+                const long ms = args.GetLong(0);
+                _timers.push({Clock::now() + std::chrono::milliseconds(ms), vm});
+                vm->Suspend();
+            }
+
+            size_t Pending() const { return _timers.size(); }
+
+            // 等待最早的定时器到期, 返回所有到期的虚拟机
+            std::vector<VMAsm::VirtualMachine*> Wait() {
+                std::vector<VMAsm::VirtualMachine*> ready;
+                if (_timers.empty()) return ready;
+
+                Arm(_timers.top().deadline);
+                epoll_event event{};
+                while (epoll_wait(_epoll, &event, 1, -1) < 0) {
+                    if (errno != EINTR) throw std::runtime_error(std::string("epoll_wait: ") + std::strerror(errno));
+                }
+                uint64_t expirations;
+                if (read(_timer, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN) {
+                    throw std::runtime_error(std::string("timerfd read: ") + std::strerror(errno));
+                }
+
+                const auto now = Clock::now();
+                while (!_timers.empty() && _timers.top().deadline <= now) {
+                    ready.push_back(_timers.top().vm);
+                    _timers.pop();
+                }
+                return ready;
+            }
+
+        private:
+            int _epoll = -1;
+            int _timer = -1;
+            std::priority_queue<Timer, std::vector<Timer>, std::greater<>> _timers{};
+
+            void Arm(const Clock::time_point deadline) {
+                auto delay = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - Clock::now()).count();
+                if (delay <= 0) delay = 1; // 已经到期, 仍需让 timerfd 触发一次
+
+                itimerspec spec{};
+                spec.it_value.tv_sec = delay / 1000000000;
+                spec.it_value.tv_nsec = delay % 1000000000;
+                timerfd_settime(_timer, 0, &spec, nullptr);
+            }
+    };
+}
+
+int main(const int argc, char *argv[]) {
+    const size_t count = argc > 1 ? std::stoul(argv[1]) : 10000;
+
+    try {
+        EventLoop loop;
+        const auto program = VMAsm::Compiler().CompileString(Source);
+
+        // 所有虚拟机共享同一份程序, 各自持有寄存器与挂起位置
+        std::vector<std::unique_ptr<VMAsm::VirtualMachine>> vms;
+        vms.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            auto vm = std::make_unique<VMAsm::VirtualMachine>();
+            VMAsm::SysCallRegistry::Init(vm.get());
+            vm->RegisterSyscall(SysSleep, [&loop](VMAsm::VirtualMachine *self, const VMAsm::SyscallArgs &args) {
+                loop.Sleep(self, args);
+            });
+            vm->Attach(program);
+
+            VMAsm::Value delay;
+            delay.write<long>(1 + static_cast<long>(i % 50));
+            vm->SetRegisterValue(3, delay);
+            vms.push_back(std::move(vm));
+        }
+
+        const auto begin = Clock::now();
+        size_t finished = 0;
+        size_t resumes = 0;
+        size_t peak = 0;
+
+        for (const auto &vm : vms) {
+            if (vm->Execute() != VMAsm::StatusSuspended) ++finished;
+        }
+
+        while (loop.Pending() != 0) {
+            peak = std::max(peak, loop.Pending());
+            for (VMAsm::VirtualMachine *vm : loop.Wait()) {
+                ++resumes;
+                if (vm->Resume() != VMAsm::StatusSuspended) ++finished;
+            }
+        }
+
+        const double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+
+        size_t completed_sleeps = 0;
+        for (const auto &vm : vms) completed_sleeps += vm->GetRegisterValue(2).to<long>();
+
+        std::cout << "virtual machines:       " << count << "\n"
+                  << "finished:               " << finished << "\n"
+                  << "peak suspended at once: " << peak << "\n"
+                  << "resumes:                " << resumes << "\n"
+                  << "completed sleeps:       " << completed_sleeps << "\n"
+                  << "wall time:              " << seconds << " s (one thread)\n";
+        return finished == count ? 0 : 1;
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+}
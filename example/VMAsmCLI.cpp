@@ -27,6 +27,7 @@
  * SOFTWARE.
  *******************************************************************************/
 
+#include <cctype>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
@@ -35,7 +36,9 @@
 #include "vmasm/compiler.hpp"
 
 #include "vmasm/disassembler.hpp"
+#include "vmasm/profiler.hpp"
 #include "vmasm/syscalls.hpp"
+#include "vmasm/trace.hpp"
 #include "vmasm/vm.hpp"
 #include "vmasm/vm_serializer.hpp"
 
@@ -51,10 +54,18 @@ void printHelp() {
               << "Options:\n"
               << "  -o, --output <file>  Specify output file\n"
               << "  -v, --verbose        Enable verbose output\n"
+              << "  -O, -O<level>        Optimize bytecode (build only): 0 none, 1 constant folding and peephole rules,\n"
+              << "                       2 also jump threading and dead code elimination (the level for -O)\n"
+              << "  --jit                Compile hot loops to native code (run only)\n"
+              << "  --profile            Print a hot-spot report to stderr after running (run only)\n"
+              << "  --flamegraph <file>  Sample execution and write collapsed stacks for flamegraph.pl (run only)\n"
+              << "  --trace <file>       run: record the last executed instructions to <file>\n"
+              << "                       disasm: decode <file> against the given bytecode\n"
               << "  -h, --help           Show this help message\n";
 }
 
-int runCommand(const std::vector<std::string>& args) {
+int runCommand(const std::vector<std::string>& args, const bool verbose, const bool jit, const bool profile,
+               const std::string& flamegraph, const std::string& trace) {
     if (args.empty()) {
         std::cerr << "Error: No input file specified for run command\n";
         return 1;
@@ -76,17 +87,65 @@ int runCommand(const std::vector<std::string>& args) {
             return 1;
         }
 
+        if (jit && !vm.SetJitEnabled(true)) {
+            std::cerr << "Warning: JIT is not supported on this platform, falling back to the interpreter\n";
+        }
+
+        // The profiler runs its own counting loop, so it takes precedence over the JIT
+        if (profile && !vm.SetProfilingEnabled(true)) {
+            std::cerr << "Warning: this build has no profiler (configure with -DVMASM_PROFILE=ON)\n";
+        }
+
+        // The VM writes the trace itself on halt or on an exception; a normal end is handled below
+        if (!trace.empty()) {
+            vm.StartTrace(VMAsm::DefaultTraceCapacity, trace);
+        }
+
         // Execute
-        vm.Execute();
+        VMAsm::SamplingProfiler sampler;
+        if (flamegraph.empty()) vm.Execute();
+        else sampler.Execute(vm);
 
-        return 0;
+        if (verbose) {
+            std::cout << "\nExecuted " << vm.GetInstructionCount() << " instruction(s)\n";
+            std::cout << "\nSuperinstructions:\n";
+            for (const auto& [pattern, sites, saved] : vm.GetFusionStats()) {
+                std::cout << "  " << pattern << ": " << sites << " site(s), "
+                          << saved << " dispatch(es) saved per execution\n";
+            }
+        }
+
+        if (!trace.empty() && !vm.DumpTrace(trace)) {
+            std::cerr << "Error: Cannot write " << trace << "\n";
+            return 1;
+        }
+
+        if (!flamegraph.empty()) {
+            std::ofstream out(flamegraph);
+            if (!out) {
+                std::cerr << "Error: Cannot write " << flamegraph << "\n";
+                return 1;
+            }
+            out << sampler.Collapse();
+            if (verbose) {
+                std::cout << "\nWrote " << sampler.GetSampleCount() << " sample(s) to " << flamegraph << "\n";
+            }
+        }
+
+        if (const VMAsm::Profile *report = vm.GetProfile()) {
+            std::cerr << "\n" << report->Report(*vm.GetProgram());
+        }
+
+        // sys 2 only stops the VM, so hand its exit code to the process here
+        return vm.GetExitCode();
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << "\n";
         return 1;
     }
 }
 
-int buildCommand(const std::vector<std::string>& args, const std::string& outputFile, const bool verbose) {
+int buildCommand(const std::vector<std::string>& args, const std::string& outputFile, const bool verbose,
+                 const int optimization) {
     if (args.empty()) {
         std::cerr << "Error: No input files specified for build command\n";
         return 1;
@@ -107,8 +166,20 @@ int buildCommand(const std::vector<std::string>& args, const std::string& output
             std::cout << "Compiling " << args.size() << " file(s) to " << outPath << "...\n";
         }
 
-        if (VMAsm::Compiler compiler; compiler.Compile(args, outPath)) {
+        VMAsm::Compiler compiler;
+        compiler.SetOptimizationLevel(optimization);
+        if (compiler.Compile(args, outPath)) {
             if (verbose) {
+                if (const auto& stats = compiler.GetOptimizerStats(); optimization > 0) {
+                    std::cout << "Optimizer: " << stats.folded << " folded, " << stats.propagated << " propagated, "
+                              << stats.branches << " branch(es) resolved, " << stats.threaded << " threaded, "
+                              << stats.inverted << " inverted, " << stats.fallthrough << " fallthrough jump(s), "
+                              << stats.unreachable << " unreachable, "
+                              << stats.dead_stores << " dead store(s), " << stats.removed << " instruction(s) removed\n";
+                    for (const auto& [rule, hits] : stats.peephole) {
+                        if (hits > 0) std::cout << "  peephole " << rule << ": " << hits << " hit(s)\n";
+                    }
+                }
                 std::cout << "Compilation successful. Output written to " << outPath << "\n";
             }
             return 0;
@@ -122,7 +193,8 @@ int buildCommand(const std::vector<std::string>& args, const std::string& output
     }
 }
 
-int disasmCommand(const std::vector<std::string>& args, const std::string& outputFile, const bool verbose) {
+int disasmCommand(const std::vector<std::string>& args, const std::string& outputFile, const bool verbose,
+                  const std::string& trace) {
     if (args.empty()) {
         std::cerr << "Error: No input file specified for disasm command\n";
         return 1;
@@ -153,7 +225,16 @@ int disasmCommand(const std::vector<std::string>& args, const std::string& outpu
             *out << "// Generated by VMAsm Tools\n\n";
         }
 
-        *out << VMAsm::Disassembler().DisassembleFile(inputFile);
+        if (trace.empty()) {
+            *out << VMAsm::Disassembler().DisassembleFile(inputFile);
+        } else {
+            VMAsm::VirtualMachine vm;
+            if (!VMAsm::VMSerializer::LoadFromFile(&vm, inputFile)) {
+                std::cerr << "Error: Could not load " << inputFile << "\n";
+                return 1;
+            }
+            *out << VMAsm::Disassembler().DisassembleTrace(trace, &vm);
+        }
 
         return 0;
     } catch (const std::exception& e) {
@@ -172,6 +253,11 @@ int main(const int argc, char* argv[]) {
     std::vector<std::string> args;
     std::string outputFile;
     bool verbose = false;
+    bool jit = false;
+    bool profile = false;
+    std::string flamegraph;
+    std::string trace;
+    int optimization = VMAsm::OptimizeNone;
 
     // Parse options
     for (int i = 2; i < argc; ++i) {
@@ -180,6 +266,18 @@ int main(const int argc, char* argv[]) {
             return 0;
         } else if (arg == "-v" || arg == "--verbose") {
             verbose = true;
+        } else if (arg == "-O") {
+            optimization = VMAsm::OptimizeDeadCode;
+        } else if (arg.size() == 3 && arg.compare(0, 2, "-O") == 0 && std::isdigit(static_cast<unsigned char>(arg[2]))) {
+            optimization = arg[2] - '0';
+        } else if (arg == "--jit") {
+            jit = true;
+        } else if (arg == "--profile") {
+            profile = true;
+        } else if (arg == "--flamegraph" && i + 1 < argc) {
+            flamegraph = argv[++i];
+        } else if (arg == "--trace" && i + 1 < argc) {
+            trace = argv[++i];
         } else if ((arg == "-o" || arg == "--output") && i + 1 < argc) {
             outputFile = argv[++i];
         } else {
@@ -188,13 +286,13 @@ int main(const int argc, char* argv[]) {
     }
 
     if (command == "run") {
-        return runCommand(args);
+        return runCommand(args, verbose, jit, profile, flamegraph, trace);
     }
     if (command == "build") {
-        return buildCommand(args, outputFile, verbose);
+        return buildCommand(args, outputFile, verbose, optimization);
     }
     if (command == "disasm") {
-        return disasmCommand(args, outputFile, verbose);
+        return disasmCommand(args, outputFile, verbose, trace);
     }
     std::cerr << "Error: Unknown command '" << command << "'\n";
     printHelp();
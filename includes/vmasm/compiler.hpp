@@ -30,15 +30,21 @@
 #pragma once
 
 #include <cstdint>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
+#include "vmasm/optimizer.hpp"
+
 namespace VMAsm {
 
     struct Instruction;
     struct Value;
     class VirtualMachine;
+    class Program;
 
     class Compiler {
         public:
@@ -47,6 +53,17 @@ namespace VMAsm {
             bool Compile(const std::vector<std::string>& sources, VirtualMachine* vm);
             bool Compile(const std::vector<std::string>& sources, const std::string& outPath);
 
+            // 编译为可共享的程序映像, 可挂载到任意数量的虚拟机
+            std::shared_ptr<const Program> CompileString(const std::string& context);
+            std::shared_ptr<const Program> Compile(const std::vector<std::string>& sources);
+
+            // 优化级别见 OptimizeNone 等常量, 默认按源码原样输出
+            void SetOptimizationLevel(const int level) { _optimization_level = level; }
+            int GetOptimizationLevel() const { return _optimization_level; }
+            const OptimizerStats& GetOptimizerStats() const { return _optimizer_stats; }
+            // 自定义窥孔规则, 优化级别不低于 OptimizeConstants 时在内置规则之后尝试
+            void AddPeepholeRule(PeepholeRule rule) { _peephole_rules.push_back(std::move(rule)); }
+
         private:
             struct LabelInfo {
                 size_t instruction_index;
@@ -57,36 +74,48 @@ namespace VMAsm {
             // 编译状态
             std::unordered_map<std::string, LabelInfo> _labels;
             std::unordered_map<std::string, long> _tables;
+            // #table 声明的入口名, 标签在 GenerateTables 之后同样进入 _tables
+            std::unordered_set<std::string> _entries;
             std::vector<Instruction> _instructions;
             std::vector<std::string> _source_files;
+            int _optimization_level{OptimizeNone};
+            OptimizerStats _optimizer_stats{};
+            std::vector<PeepholeRule> _peephole_rules;
+
+            // 词法分析的输出缓冲, 各行复用; token 指向源码缓冲区, 不复制字符串
+            std::vector<std::string_view> _tokens;
 
             // 核心方法
-            void ProcessLine(std::string line, size_t file_idx, int line_num, bool& in_comment_block);
+            void ParseSource(std::string_view source, size_t file_idx);
+            void ProcessLine(const std::vector<std::string_view>& tokens, size_t file_idx, int line_num);
             bool ParseString(const std::string& source);
             bool ParseFiles(const std::vector<std::string>& sources);
             void ResolveReferences();
             void GenerateTables();
+            void Optimize();
 
             // 工具方法
-            static Instruction ParseInstruction(const std::string &line, size_t file_idx, int line_num);
+            static Instruction ParseInstruction(const std::vector<std::string_view>& tokens);
 
-            static Value ParseValue(const std::string& token);
+            static Value ParseValue(std::string_view token);
 
-            static std::vector<std::string> Tokenize(const std::string& line);
+            // 把一行切分为 token, 注释视为空白; 块注释可以跨行, 状态保存在 in_comment_block 中
+            static void Tokenize(std::string_view line, bool& in_comment_block, std::vector<std::string_view>& tokens);
 
             // 类型判断
-            static bool IsRegister(const std::string& token);
-            static bool IsTableRef(const std::string& token);
-            static bool IsByteArray(const std::string& token);
-            static bool IsStringLiteral(const std::string& token);
-            static bool IsFloat(const std::string& token);
-            static bool IsInteger(const std::string& token);
+            static bool IsRegister(std::string_view token);
+            static bool IsTableRef(std::string_view token);
+            static bool IsByteArray(std::string_view token);
+            static bool IsStringLiteral(std::string_view token);
+            static bool IsFloat(std::string_view token);
+            static bool IsInteger(std::string_view token);
 
             // 转换方法
-            static std::string ToLower(std::string s);
-            static std::string Trim(std::string s);
-            static std::vector<uint8_t> ParseByteArray(const std::string& token);
-            static std::string UnescapeString(const std::string &s);
+            static std::string ToLower(std::string_view s);
+            static std::string_view Trim(std::string_view s);
+            static long ParseInteger(std::string_view token);
+            static std::vector<uint8_t> ParseByteArray(std::string_view token);
+            static std::string UnescapeString(std::string_view s);
     };
 
 }
\ No newline at end of file
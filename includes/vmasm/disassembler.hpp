@@ -44,9 +44,13 @@ namespace VMAsm {
             std::string DisassembleFile(const std::string& src_path);
             std::string Disassemble(VirtualMachine* vm);
 
+            // 逐条打印执行跟踪, vm 中须加载记录时的同一程序
+            std::string DisassembleTrace(const std::string& trace_path, VirtualMachine* vm);
+
         private:
             // 反汇编工具方法
-            std::string DisassembleInstruction(const Instruction& instr);
+            std::string DisassembleInstruction(const Instruction& instr, long index);
+            std::string DisassembleOperation(const Instruction& instr);
             std::string ValueToString(const Value& val);
 
             static bool IsValidDouble(double d);
@@ -59,7 +63,6 @@ namespace VMAsm {
 
             // 反向查找表
             std::unordered_map<long, std::string> _labelMap;
-            std::unordered_map<long, std::string> _tableMap;
 
 
             void BuildReverseMaps(VirtualMachine* vm);
@@ -0,0 +1,123 @@
+/*******************************************************************************
+ * 文件名称: executor
+ * 项目名称: TEFModLoader
+ * 创建时间: 2026/10/16
+ * 作者: EternalFuture゙
+ * Github: https://github.com/eternalfuture-e38299
+ * 版权声明: Copyright © 2025 EternalFuture゙
+ * 
+ * MIT License
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "vm.hpp"
+
+namespace VMAsm {
+
+    // 一个执行任务: 在新的虚拟机中挂载 program, 写入初始寄存器后从 entry 开始执行
+    struct Job {
+        std::shared_ptr<const Program> program{};
+        std::string entry = "main";
+        std::vector<std::pair<uint8_t, Value>> registers{};
+    };
+
+    struct JobResult {
+        int status{};                   // Execute 的返回值
+        int exit_code{};                // 通过 sys 2 设置的退出码
+        bool failed{};                  // 准备或执行时抛出了异常, 或任务没有程序
+        std::string error{};
+        uint64_t instructions{};        // 执行的指令数
+        std::vector<Value> registers{}; // 结束时的全部寄存器
+    };
+
+    struct ExecutorStats {
+        size_t jobs{};
+        uint64_t instructions{};
+        double seconds{};
+
+        double JobsPerSecond() const { return seconds > 0 ? static_cast<double>(jobs) / seconds : 0; }
+        double InstructionsPerSecond() const { return seconds > 0 ? static_cast<double>(instructions) / seconds : 0; }
+    };
+
+    // 多实例并行执行器: 常驻的工作线程各自持有一个任务队列,
+    // 从自己队列的尾部取任务, 空闲时从其他线程队列的头部窃取
+    class Executor {
+        public:
+            typedef std::function<void(VirtualMachine& vm)> Setup;
+
+            // threads 为 0 时使用硬件线程数
+            explicit Executor(size_t threads = 0);
+            Executor(const Executor&) = delete;
+            Executor& operator=(const Executor&) = delete;
+            ~Executor();
+
+            // 每个任务的虚拟机创建后调用, 默认注册 SysCallRegistry 中的系统调用
+            void SetSetup(Setup setup) { _setup = std::move(setup); }
+            void SetJitEnabled(const bool enabled) { _jit = enabled; }
+
+            // 执行一批任务并等待全部完成, 结果与 jobs 一一对应
+            std::vector<JobResult> Run(const std::vector<Job>& jobs);
+
+            const ExecutorStats& GetStats() const { return _stats; }
+            size_t GetThreadCount() const { return _workers.size(); }
+
+        private:
+            struct Worker {
+                std::mutex lock;
+                std::deque<size_t> queue;
+                std::thread thread;
+            };
+            std::vector<std::unique_ptr<Worker>> _workers{};
+
+            std::mutex _lock;
+            std::condition_variable _wake;
+            std::condition_variable _done;
+            uint64_t _generation = 0;
+            bool _stopping = false;
+
+            // 当前批次, 由 Run 设置
+            const std::vector<Job> *_jobs = nullptr;
+            std::vector<JobResult> *_results = nullptr;
+            std::atomic<size_t> _remaining{0};
+            std::atomic<uint64_t> _instructions{0};
+
+            Setup _setup{};
+            bool _jit = false;
+            ExecutorStats _stats{};
+
+            void WorkerLoop(size_t index);
+            bool Take(size_t index, size_t &job);
+            void Execute(size_t job);
+    };
+}
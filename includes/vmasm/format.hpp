@@ -0,0 +1,61 @@
+/*******************************************************************************
+ * 文件名称: format
+ * 项目名称: TEFModLoader
+ * 创建时间: 2026/10/16
+ * 作者: EternalFuture゙
+ * Github: https://github.com/eternalfuture-e38299
+ * 版权声明: Copyright © 2025 EternalFuture゙
+ * 
+ * MIT License
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace VMAsm {
+
+    // 格式串片段: spec 为 0 时是字面文本 text[offset, offset + length), 否则是一个参数占位符
+    struct FormatPiece {
+        uint32_t offset{};
+        uint32_t length{};
+        char spec{};
+    };
+
+    // 预解析的 printf 风格格式串, 支持 %d %f %s %c %x 与 %%.
+    // 常量格式串在加载时解析一次, 执行时只按片段拼接
+    class Format {
+        std::string _text{};
+        std::vector<FormatPiece> _pieces{};
+        size_t _arguments{};
+
+        public:
+            // 说明符不合法时抛出异常
+            static Format Parse(std::string_view format);
+
+            const std::string& GetText() const { return _text; }
+            const std::vector<FormatPiece>& GetPieces() const { return _pieces; }
+            size_t GetArgumentCount() const { return _arguments; }
+    };
+}
@@ -0,0 +1,83 @@
+/*******************************************************************************
+ * 文件名称: jit
+ * 项目名称: TEFModLoader
+ * 创建时间: 2026/10/16
+ * 作者: EternalFuture゙
+ * Github: https://github.com/eternalfuture-e38299
+ * 版权声明: Copyright © 2025 EternalFuture゙
+ * 
+ * MIT License
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(__x86_64__) && !defined(_WIN32)
+#define VMASM_JIT_SUPPORTED 1
+#else
+#define VMASM_JIT_SUPPORTED 0
+#endif
+
+namespace VMAsm {
+
+    struct Instruction;
+    struct DecodedInstruction;
+    struct Register;
+
+    // 编译后的区域: 参数为寄存器文件首地址、已执行指令计数与本次进入可执行的指令预算,
+    // 返回下一条要执行的指令下标. 区域内的回边在预算耗尽时离开区域.
+    // 返回值等于区域入口表示守卫失败, 调用方应先解释执行入口指令
+    typedef long (*JitFunction)(Register *regs, uint64_t *retired, uint64_t budget);
+
+    // x86-64 模板 JIT: 把从入口开始的一段连续、只含整数运算与静态跳转的指令翻译为机器码.
+    // 区域内的跳转直接编译为本地跳转, 离开区域时返回目标下标交回解释器
+    class JitCompiler {
+        public:
+            JitCompiler() = default;
+            JitCompiler(const JitCompiler&) = delete;
+            JitCompiler& operator=(const JitCompiler&) = delete;
+            ~JitCompiler();
+
+            static bool IsSupported() { return VMASM_JIT_SUPPORTED; }
+
+            // 编译从 entry 开始的区域, 入口指令不受支持时返回 nullptr
+            JitFunction Compile(const std::vector<Instruction>& instructions,
+                                const std::vector<DecodedInstruction>& decoded, long entry);
+
+            // 释放全部已编译代码
+            void Reset();
+
+            static constexpr size_t MaxRegionLength = 256;
+
+        private:
+            struct Chunk {
+                uint8_t *memory;
+                size_t size;
+                size_t used;
+            };
+            std::vector<Chunk> _chunks{};
+
+            void *Install(const std::vector<uint8_t>& code);
+    };
+}
@@ -0,0 +1,141 @@
+/*******************************************************************************
+ * 文件名称: optimizer
+ * 项目名称: TEFModLoader
+ * 创建时间: 2026/10/16
+ * 作者: EternalFuture゙
+ * Github: https://github.com/eternalfuture-e38299
+ * 版权声明: Copyright © 2025 EternalFuture゙
+ * 
+ * MIT License
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace VMAsm {
+
+    struct Value;
+    struct Instruction;
+    enum class OpCode : uint8_t;
+
+    // 窥孔规则: sequence 匹配相邻指令的操作码, rewrite 再检查操作数并给出替换结果.
+    // rewrite 返回 false 表示不适用; replacement 不能多于窗口中的指令, 留空表示删除整个窗口.
+    // 窗口不会跨越跳转目标或表入口, 替换结果中的跳转目标沿用优化前的指令下标.
+    // 与窗口完全相同的替换结果视为不适用; 规则之间反复改写无法收敛时 Run 抛出 std::runtime_error
+    struct PeepholeRule {
+        std::string name{};
+        std::vector<OpCode> sequence{};
+        std::function<bool(const std::vector<Instruction>& window, std::vector<Instruction>& replacement)> rewrite{};
+    };
+
+    // 某条窥孔规则的命中次数
+    struct PeepholeStat {
+        std::string rule{};
+        size_t hits{};
+    };
+
+    // 各优化的命中次数
+    struct OptimizerStats {
+        size_t folded{};        // 折叠为 mov 立即数的 add/sub/neg, 以及化简掉的整数恒等运算 (x + 0 等)
+        size_t propagated{};    // 替换为立即数的寄存器操作数
+        size_t branches{};      // 条件已知而化简的条件跳转
+        std::vector<PeepholeStat> peephole{}; // 按规则顺序, 内置规则在前
+        size_t threaded{};      // 改为直接跳到跳转链终点的跳转
+        size_t inverted{};      // 条件跳转越过无条件跳转, 取反后删除无条件跳转
+        size_t fallthrough{};   // 跳到下一条指令而被删除的跳转
+        size_t unreachable{};   // 从任何入口都无法到达的指令
+        size_t dead_stores{};   // 写入的寄存器在被读取前就被覆盖的指令
+        size_t removed{};       // 删除的指令
+    };
+
+    // 优化级别
+    constexpr int OptimizeNone = 0;       // 按源码原样输出
+    constexpr int OptimizeConstants = 1;  // 常量传播与折叠, 窥孔规则
+    constexpr int OptimizeDeadCode = 2;   // 另外串联跳转, 删除不可达代码与死存储
+
+    // 编译期优化: 在引用绑定与校验之后原地改写指令序列.
+    // 删除指令后重新映射表与跳转目标, 因此含寄存器间接跳转 (目标无法静态得知) 的程序保持原样
+    class Optimizer {
+        public:
+            explicit Optimizer(int level = OptimizeDeadCode) : _level(level) {}
+
+            // entries 为 #table 声明的入口; 宿主只从这些入口、main 与程序开头开始执行, 普通标签只是跳转目标
+            void Run(std::vector<Instruction>& instructions, std::unordered_map<std::string, long>& tables,
+                     const std::unordered_set<std::string>& entries);
+
+            // 追加一条窥孔规则, 在内置规则之后尝试
+            void AddRule(PeepholeRule rule) { _rules.push_back(std::move(rule)); }
+            static const std::vector<PeepholeRule>& GetBuiltinRules();
+
+            const OptimizerStats& GetStats() const { return _stats; }
+
+        private:
+            // 基本块内各寄存器的已知整数值
+            typedef std::array<std::optional<long>, 64> Constants;
+            // 寄存器集合, 第 i 位表示 Ri
+            typedef uint64_t Registers;
+
+            int _level;
+            OptimizerStats _stats{};
+            std::vector<bool> _removed{};
+            std::vector<PeepholeRule> _rules{};
+
+            void FoldConstants(std::vector<Instruction>& instructions, const std::vector<bool>& leaders);
+            void ApplyPeephole(std::vector<Instruction>& instructions,
+                               const std::unordered_map<std::string, long>& tables);
+            bool ApplyRule(std::vector<Instruction>& instructions, const std::vector<bool>& leaders,
+                           const PeepholeRule& rule, size_t pc);
+            void ThreadJumps(std::vector<Instruction>& instructions);
+            void InvertBranches(std::vector<Instruction>& instructions, const std::vector<bool>& leaders);
+            void RemoveFallthroughJumps(const std::vector<Instruction>& instructions);
+            void RemoveUnreachable(const std::vector<Instruction>& instructions,
+                                   const std::unordered_map<std::string, long>& tables,
+                                   const std::unordered_set<std::string>& entries);
+            bool RemoveDeadStores(const std::vector<Instruction>& instructions);
+            void Compact(std::vector<Instruction>& instructions, std::unordered_map<std::string, long>& tables);
+
+            // 寄存器操作数的值已知时替换为立即数, 返回操作数的值
+            std::optional<long> Propagate(Value& value, const Constants& known);
+
+            // pc 起第一条未删除的指令, 全部删除时为程序长度
+            size_t NextKept(size_t pc) const;
+            // 沿无条件跳转链找到最终目标, 遇到环时返回原目标
+            size_t Resolve(const std::vector<Instruction>& instructions, size_t target) const;
+
+            // 控制流后继, 返回个数; 执行到末尾或停机时后继为程序长度
+            size_t Successors(const std::vector<Instruction>& instructions, size_t pc, size_t next[2]) const;
+            // 指令读取与写入的寄存器
+            static void Access(const Instruction& instruction, Registers& use, Registers& def);
+
+            static bool HasIndirectJumps(const std::vector<Instruction>& instructions);
+            static std::vector<bool> FindLeaders(const std::vector<Instruction>& instructions,
+                                                 const std::unordered_map<std::string, long>& tables);
+    };
+
+}
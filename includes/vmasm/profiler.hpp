@@ -0,0 +1,88 @@
+/*******************************************************************************
+ * 文件名称: profiler
+ * 项目名称: TEFModLoader
+ * 创建时间: 2026/10/16
+ * 作者: EternalFuture゙
+ * Github: https://github.com/eternalfuture-e38299
+ * 版权声明: Copyright © 2025 EternalFuture゙
+ * 
+ * MIT License
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "vm.hpp"
+
+namespace VMAsm {
+
+    constexpr size_t OpCodeCount = static_cast<size_t>(OpCode::ADD_SUB_JNZ) + 1;
+
+    struct SyscallProfile {
+        uint64_t calls{};
+        uint64_t nanoseconds{};     // 处理函数的累计耗时
+    };
+
+    // 剖析结果. 剖析时执行不融合的映像, 计数与程序中的指令一一对应
+    struct Profile {
+        std::vector<uint64_t> instructions{};               // 按指令下标的执行次数
+        std::array<uint64_t, OpCodeCount> opcodes{};        // 按指令类型的执行次数
+        std::array<SyscallProfile, SyscallCount> syscalls{};
+
+        void Reset(size_t size);
+        uint64_t GetTotal() const;
+
+        // 按执行次数排序的热点报告, 每条指令归属到下标不超过它的最近一个标签
+        std::string Report(const Program &program, size_t limit = 20) const;
+    };
+
+    constexpr uint64_t DefaultSampleInterval = 10000;
+
+    // 采样剖析: 以指令预算分段执行, 每执行约 interval 条指令在随后的跳转处记录一次 PC.
+    // 分派循环本身不变, 开销只是每段一次的暂停与恢复. 样本总落在跳转目标上, 适合按标签汇总
+    class SamplingProfiler {
+        uint64_t _interval;
+        std::string _entry{};
+        std::shared_ptr<const Program> _program{};
+        std::vector<uint64_t> _samples{};   // 按指令下标的样本数
+
+        int Continue(VirtualMachine &vm, int status);
+
+        public:
+            explicit SamplingProfiler(uint64_t interval = DefaultSampleInterval);
+
+            // 与 VirtualMachine 的同名方法相同, 只是在内部消化采样造成的暂停.
+            // 返回 StatusSuspended 时由宿主完成异步操作后调用 Resume
+            int Execute(VirtualMachine &vm, const std::string &table = "main");
+            int Resume(VirtualMachine &vm);
+
+            uint64_t GetSampleCount() const;
+            void Reset();
+
+            // flamegraph.pl 可读的折叠栈文本, 每行为 "入口;标签 样本数"
+            std::string Collapse() const;
+    };
+}
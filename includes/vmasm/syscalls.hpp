@@ -29,17 +29,15 @@
 
 #pragma once
 
-#include <vector>
-
 namespace VMAsm {
 
-    struct Value;
+    class SyscallArgs;
     class VirtualMachine;
 
     class SysCallRegistry {
-        static void SysPrint(VirtualMachine* vm, const std::vector<Value>& args);
-        static void SysExit(VirtualMachine *vm, const std::vector<Value> &args);
-        static void SysRand(VirtualMachine *vm, const std::vector<Value> &args);
+        static void SysPrint(VirtualMachine *vm, const SyscallArgs &args);
+        static void SysExit(VirtualMachine *vm, int code);
+        static void SysRand(VirtualMachine *vm, const SyscallArgs &args);
 
         public:
             static void Init(VirtualMachine* vm);
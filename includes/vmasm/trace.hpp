@@ -0,0 +1,85 @@
+/*******************************************************************************
+ * 文件名称: trace
+ * 项目名称: TEFModLoader
+ * 创建时间: 2026/10/16
+ * 作者: EternalFuture゙
+ * Github: https://github.com/eternalfuture-e38299
+ * 版权声明: Copyright © 2025 EternalFuture゙
+ * 
+ * MIT License
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "vm.hpp"
+
+namespace VMAsm {
+
+    constexpr uint8_t TraceNoRegister = 0xFF;
+
+    // 一条执行记录: 指令下标、操作码, 以及执行后目标寄存器的值 (按整数读取的前 8 个字节)
+    struct TraceRecord {
+        uint32_t pc{};
+        OpCode code{};
+        uint8_t reg = TraceNoRegister;  // 目标寄存器, 没有目标寄存器的指令为 TraceNoRegister
+        uint16_t reserved{};
+        uint64_t value{};
+    };
+
+    static_assert(sizeof(TraceRecord) == 16, "TraceRecord must stay 16 bytes");
+
+    // 定长环形缓冲区, 只保留最近的记录. 只由执行该虚拟机的线程写入, 不需要加锁
+    class TraceBuffer {
+        std::vector<TraceRecord> _records{};
+        uint64_t _written{};
+        uint64_t _mask{};
+
+        public:
+            // 容量向上取整为 2 的幂
+            explicit TraceBuffer(size_t capacity = DefaultTraceCapacity);
+
+            TraceRecord &Append() { return _records[_written++ & _mask]; }
+            void Clear() { _written = 0; }
+
+            size_t GetCapacity() const { return _records.size(); }
+            uint64_t GetWritten() const { return _written; }
+            size_t Size() const { return _written < _records.size() ? static_cast<size_t>(_written) : _records.size(); }
+
+            // 按执行顺序 (由旧到新) 返回缓冲区中的记录
+            std::vector<TraceRecord> GetRecords() const;
+
+            // 二进制格式: "VMTR", 版本, 程序指令数, 累计记录数, 文件中的记录数, 之后为定长记录
+            bool Save(const std::string &filename, const Program &program) const;
+    };
+
+    // 从文件读回的跟踪记录
+    struct TraceFile {
+        uint64_t instructions{};    // 记录时的程序指令数, 用于核对反汇编所用的程序
+        uint64_t written{};         // 累计记录数, 大于 records.size() 时较早的记录已被覆盖
+        std::vector<TraceRecord> records{};
+
+        static bool Load(const std::string &filename, TraceFile &trace);
+    };
+}
@@ -0,0 +1,61 @@
+/*******************************************************************************
+ * 文件名称: verifier
+ * 项目名称: TEFModLoader
+ * 创建时间: 2026/10/16
+ * 作者: EternalFuture゙
+ * Github: https://github.com/eternalfuture-e38299
+ * 版权声明: Copyright © 2025 EternalFuture゙
+ * 
+ * MIT License
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace VMAsm {
+
+    struct Value;
+    struct Instruction;
+
+    // 加载期字节码校验: 在编译结果与从文件读入的字节码交给虚拟机之前检查一次.
+    // 通过校验的程序解码后, 分派循环不再需要逐条检查操作数数量、寄存器下标和静态跳转目标
+    class Verifier {
+        public:
+            // 校验失败时抛出 std::runtime_error, 信息中带有出错的指令下标
+            static void Verify(const std::vector<Instruction>& instructions,
+                               const std::unordered_map<std::string, long>& tables);
+
+            // 校验单条指令, size 为程序长度 (跳转目标的上界)
+            static void VerifyInstruction(const Instruction& instruction, size_t pc, size_t size);
+
+        private:
+
+            static void RequireRegister(const Value& value, size_t pc, size_t index);
+            static void RequireOperand(const Value& value, size_t pc, size_t index);
+            static void RequireTarget(const Value& value, size_t pc, size_t index, size_t size);
+
+            [[noreturn]] static void Fail(size_t pc, const std::string& message);
+    };
+
+}
@@ -29,13 +29,25 @@
  
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
+#include <deque>
 #include <functional>
-#include <list>
+#include <memory>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include "format.hpp"
+#include "jit.hpp"
+
 namespace VMAsm {
 
     enum class OpCode : uint8_t {
@@ -59,12 +71,46 @@ namespace VMAsm {
 
         // 系统指令
         HALT,       // 停机
-        SYS         // 系统调用
+        SYS,        // 系统调用
+
+        // 快照栈指令
+        SNAP_PUSH,  // 将寄存器压入快照栈
+        SNAP_POP,   // 从快照栈弹出并恢复寄存器
+
+        // 内部指令, 仅由解码过程生成, 不会出现在字节码中
+        END,        // 程序末尾哨兵
+
+        // 超级指令: 融合相邻指令, 一次分派执行整组.
+        // 组内后续指令在解码映像中原样保留, 跳转到组中间仍然正确
+        MOV_MOV,    // mov + mov
+        MOV_ADD,    // mov + add
+        ADD_ADD,    // add + add
+        SUB_JZ,     // sub + jz  (jz 测试 sub 的目标寄存器)
+        SUB_JNZ,    // sub + jnz (jnz 测试 sub 的目标寄存器)
+        SUB_JG,     // sub + jg  (jg 测试 sub 的目标寄存器)
+        ADD_SUB_JNZ // add + sub + jnz
+    };
+
+    // Execute/Resume 的返回值
+    enum ExecuteStatus : int {
+        StatusEnd = 0,      // 执行到程序末尾
+        StatusHalt = 1,     // 执行了 halt, 或系统调用请求结束
+        StatusYielded = 2,  // 指令预算耗尽, 可调用 Resume 继续
+        StatusSuspended = 3 // 异步系统调用尚未完成, 宿主完成后调用 Resume 继续
+    };
+
+    // 不限制指令预算
+    constexpr uint64_t Unlimited = UINT64_MAX;
+
+    // 解释器的分派方式
+    enum class DispatchMode : uint8_t {
+        Switch = 0, // 可移植的 switch 循环
+        Threaded    // 直接线索化 (computed goto), 编译器不支持时退化为 Switch
     };
 
     struct Value {
         bool is_reg{};
-        bool is_table;
+        bool is_table{};    // 代码地址引用, 编译或加载后 data 中为已绑定的指令下标
         std::vector<uint8_t> data{};
 
         template<typename T>
@@ -142,35 +188,504 @@ namespace VMAsm {
         std::vector<Value> Args{};
     };
 
-    class VirtualMachine {
-        long _program_counter{};
+    // 预解码后的操作数类型
+    enum class OperandKind : uint8_t {
+        None = 0,   // 无操作数
+        Register,   // 寄存器, 载荷为寄存器下标
+        Immediate,  // 内联立即数, 载荷为 8 字节值
+        Target,     // 已解析的跳转目标, 载荷为指令下标
+        Constant    // 常量池引用 (字符串/字节数组等), 载荷为常量池下标
+    };
+
+    // 定长预解码指令, 由加载时的降级过程从 Instruction 生成, 解释器只执行这种形式
+    struct alignas(32) DecodedInstruction {
+        OpCode code{};
+        OperandKind kinds[3]{};
+        long args[3]{};
+    };
+
+    static_assert(sizeof(DecodedInstruction) == 32, "DecodedInstruction must stay 32 bytes");
+
+    // 寄存器槽中值的存放方式
+    enum class RegisterTag : uint8_t {
+        Empty = 0,  // 空寄存器
+        Inline,     // 不超过 8 字节, 直接存放在 bits 中 (不足部分补零)
+        Heap        // 超过 8 字节, bits 为 VM 数据区中的块编号
+    };
+
+    // 定长寄存器槽, 整数与浮点运算只读写 bits, 不涉及堆分配
+    struct Register {
+        uint64_t bits{};
+        uint32_t size{};
+        RegisterTag tag{};
+    };
+
+    static_assert(sizeof(Register) == 16, "Register must stay 16 bytes");
+
+    // 融合统计: 某种超级指令在解码映像中出现的位置数
+    struct FusionStat {
+        std::string pattern{};  // 指令序列, 例如 "sub+jnz"
+        size_t sites{};         // 融合位置数
+        size_t saved{};         // 每次执行该超级指令节省的分派次数
+    };
+
+    // 预解码的系统调用参数: 寄存器下标 (已校验) 或立即数的前 8 个字节
+    struct SyscallOperand {
+        long value{};
+        bool is_reg{};
+    };
+
+    // 程序中的一处系统调用, 用于在执行前核对参数个数
+    struct SyscallSite {
+        long index{};       // 指令下标
+        uint8_t id{};       // 调用编号
+        size_t arguments{}; // 不含调用编号的参数个数
+        size_t operands{};  // 参数在 GetSyscallOperands() 中的起始位置
+        long format = -1;   // 第一个参数为常量格式串时, 其解析结果在 GetFormats() 中的下标
+    };
+
+    constexpr size_t RegisterCount = 64;
+    typedef std::array<Register, RegisterCount> RegisterFile;
+
+    // 不可变的程序映像: 指令、符号表、预解码映像与常量池.
+    // 编译或加载一次后可被任意数量的虚拟机 (包括不同线程中的) 同时共享执行
+    class Program {
+        std::vector<Instruction> _instructions{};
+        std::unordered_map<std::string, long> _tables{};
+
+        // 预解码映像与常量池, 与 _instructions 一一对应, 末尾附加 END 哨兵
+        std::vector<DecodedInstruction> _decoded{};
+        std::vector<Value> _constants{};
+
+        std::vector<SyscallSite> _syscall_sites{};
+        std::vector<SyscallOperand> _syscall_operands{};
+        std::vector<Format> _formats{};
+
+        bool _fusion_enabled = true;
+        std::vector<FusionStat> _fusion_stats{};
+
+        Program(std::vector<Instruction> instructions, std::unordered_map<std::string, long> tables, bool fusion);
+
+        void Decode();
+        void Fuse();
+        void DecodeOperand(DecodedInstruction &decoded, int index, const Value &value, OperandKind expected);
+        static uint8_t DecodeRegister(const Value &value);
+        long DecodeFormat(const std::vector<Value> &args);
+
+        long ClampTarget(long target) const;
+
+        public:
+            // 解码并执行加载期优化, 程序不合法时抛出异常
+            static std::shared_ptr<const Program> Create(std::vector<Instruction> instructions,
+                                                         std::unordered_map<std::string, long> tables,
+                                                         bool fusion = true);
+            static const std::shared_ptr<const Program>& Empty();
+
+            // 查找入口, 不存在时返回 -1; 只读查找, 可在多个线程中并发调用
+            long FindTable(const std::string& name) const;
+
+            long Size() const { return static_cast<long>(_instructions.size()); }
+            const std::vector<Instruction>& GetInstructions() const { return _instructions; }
+            const std::unordered_map<std::string, long>& GetTables() const { return _tables; }
+            const std::vector<DecodedInstruction>& GetDecoded() const { return _decoded; }
+            const std::vector<Value>& GetConstants() const { return _constants; }
+            const std::vector<SyscallSite>& GetSyscallSites() const { return _syscall_sites; }
+            const std::vector<SyscallOperand>& GetSyscallOperands() const { return _syscall_operands; }
+            const std::vector<Format>& GetFormats() const { return _formats; }
+            bool IsFusionEnabled() const { return _fusion_enabled; }
+            const std::vector<FusionStat>& GetFusionStats() const { return _fusion_stats; }
+    };
+
+    class SyscallArgs;
+    class VirtualMachine;
+    struct Profile;
+    class TraceBuffer;
 
-        std::unordered_map<std::string, long> _tables;
-        std::vector<Value> _regs {64};
-        std::vector<Value> _regs_snap {64};
+    constexpr size_t DefaultTraceCapacity = 65536;
 
-        std::list<Instruction> _instructions{0};
+    typedef void (*SyscallFunction)(VirtualMachine *vm, const SyscallArgs &args);
+    typedef std::function<void(VirtualMachine *vm, const SyscallArgs &args)> VirtualMethod;
+    constexpr size_t SyscallCount = 256;
 
-        int Interpreter(const Instruction &instruction);
+    // 输出函数, 每次接收缓冲区中积累的一段完整内容
+    typedef std::function<void(std::string_view text)> OutputWriter;
+    constexpr size_t DefaultOutputBuffer = 8192;
 
-        int Run(long start);
+    // 字节数组参数的只读视图
+    struct ByteSpan {
+        const uint8_t *data{};
+        size_t size{};
+
+        const uint8_t *begin() const { return data; }
+        const uint8_t *end() const { return data + size; }
+        bool empty() const { return size == 0; }
+    };
+
+    // 系统调用参数的只读视图, 直接引用指令中的原始操作数与预解码结果, 不复制.
+    // Get* 读取时解析寄存器操作数, 返回的字符串视图在对应寄存器被改写前有效
+    class SyscallArgs {
+        const VirtualMachine *_vm{};
+        const Value *_values{};
+        const SyscallOperand *_operands{};
+        size_t _size{};
+        const Format *_format{};
+
+        const SyscallOperand &Operand(size_t index) const;
 
         public:
-            typedef std::function<void(VirtualMachine* vm, std::vector<Value>& args)> VirtualMethod;
-            std::unordered_map<int, VirtualMethod> SyscallTable;
+            SyscallArgs(const VirtualMachine *vm, const Value *values, const SyscallOperand *operands, const size_t size,
+                        const Format *format = nullptr) :
+                _vm(vm), _values(values), _operands(operands), _size(size), _format(format) {}
+
+            size_t size() const { return _size; }
+            bool empty() const { return _size == 0; }
+            const Value &operator[](const size_t index) const { return _values[index]; }
+            const Value &at(size_t index) const;
+            const Value *begin() const { return _values; }
+            const Value *end() const { return _values + _size; }
+
+            bool IsRegister(const size_t index) const { return Operand(index).is_reg; }
+            long GetLong(size_t index) const;
+            double GetDouble(size_t index) const;
+            std::string_view GetString(size_t index) const;
+            ByteSpan GetBytes(size_t index) const;
+
+            // 第一个参数是常量格式串时返回加载时的解析结果, 否则返回 nullptr
+            const Format *GetFormat() const { return _format; }
+
+            // 按类型读取: 整数、浮点数、std::string_view、std::string 或 ByteSpan, 在编译期选定读取方式
+            template<typename T>
+            T Get(size_t index) const;
+    };
+
+    class VirtualMachine {
+        friend class SyscallArgs;
+
+        long _program_counter{};
+        uint64_t _retired{};    // 累计执行的指令数 (超级指令按组内指令数计)
+
+        // 系统调用对执行流程的请求, 在 SYS 之后检查
+        enum class StopRequest : uint8_t {
+            None = 0,
+            Exit,       // 结束执行
+            Suspend     // 挂起等待异步完成
+        };
+        StopRequest _stop_request = StopRequest::None;
+        int _exit_code{};
+        int _status{};          // 上次执行的返回值, 暂停或挂起时 _program_counter 为恢复位置
+
+        // 寄存器组按引用计数共享: 保存快照只增加引用, 第一次写入共享组时才复制 (写时复制).
+        // 交换与清空只改变组编号, 0 号组固定为空寄存器组
+        struct Bank {
+            RegisterFile regs{};
+            uint32_t refs{};
+        };
+        static constexpr uint32_t EmptyBank = 0;
+        std::deque<Bank> _banks = std::deque<Bank>(1, Bank{{}, 1});
+        std::vector<uint32_t> _free_banks{};
+        uint32_t _live = AcquireEmptyBank();
+        std::vector<uint32_t> _snapshots{AcquireEmptyBank()};   // 栈顶为 snap_save/snap_swap/snap_clear 操作的快照
+        Register *_regs = _banks[_live].regs.data();            // 活动寄存器组
+        bool _live_shared = true;
+
+        // 存放超长寄存器值 (字符串、字节数组) 的数据区, 块按引用计数共享, 释放后复用其容量
+        struct Blob {
+            std::vector<uint8_t> data{};
+            uint32_t refs{};
+        };
+        std::vector<Blob> _blobs{};
+        std::vector<uint32_t> _free_blobs{};
+
+        // 当前执行的程序, 可能与其他虚拟机共享
+        std::shared_ptr<const Program> _program = Program::Empty();
+
+        // 通过 SetInstructions/SetTables/AddInstruction 逐步构建时的暂存内容, Prepare 时生成私有 Program
+        struct Builder {
+            std::vector<Instruction> instructions{};
+            std::unordered_map<std::string, long> tables{};
+        };
+        Builder _builder{};
+        bool _building = false;
+        bool _dirty = true;
+
+        bool _fusion_enabled = true;
+
+        Builder &Edit();
+
+        DispatchMode _dispatch_mode = DefaultDispatchMode();
+        static DispatchMode DefaultDispatchMode();
+
+        // JIT: 每个跳转目标 (及入口) 带一个热度计数, 归零时编译从该处开始的区域
+        struct JitSlot {
+            JitFunction function{};
+            uint32_t heat{};
+        };
+        std::shared_ptr<JitCompiler> _jit{};
+        std::vector<JitSlot> _jit_slots{};
+        uint32_t _jit_threshold = 64;
+
+        void ResetJit();
+
+        // 剖析开启时执行带计数的分派循环, 构建时未开启 VMASM_PROFILE 则不会生成相关代码
+        std::unique_ptr<Profile> _profile{};
+
+        // 执行跟踪: 开启时使用单独的分派循环, 记录写入环形缓冲区
+        std::unique_ptr<TraceBuffer> _trace{};
+        std::string _trace_path{};
+        bool _tracing = false;
+
+        long Load(const DecodedInstruction &instruction, int index) const;
+        long Branch(const DecodedInstruction &instruction, int index) const;
+
+        // 指令语义, 由普通指令与超级指令的处理函数共享
+        void ExecMov(const DecodedInstruction &instruction);
+        long ExecAdd(const DecodedInstruction &instruction);
+        long ExecSub(const DecodedInstruction &instruction);
+
+        // 寄存器组管理
+        uint32_t AcquireEmptyBank() { ++_banks[EmptyBank].refs; return EmptyBank; }
+        void ReleaseBank(uint32_t bank);
+        void BindLive();
+        void Unshare();
+        Register &Dst(long index);
+
+        // 寄存器读写
+        uint32_t AllocBlob(const uint8_t *data, size_t size);
+        void Retain(const Register &reg);
+        void Release(Register &reg);
+        void Assign(Register &dst, const Register &src);
+        void Write(Register &dst, long value);
+        void Write(Register &dst, const Value &value);
+        void Clear(RegisterFile &regs);
+        long ReadLong(const Register &reg) const {
+            if (reg.tag != RegisterTag::Heap) return static_cast<long>(reg.bits);
+
+            long value;
+            std::memcpy(&value, _blobs[reg.bits].data.data(), sizeof(long));
+            return value;
+        }
+        Value ReadValue(const Register &reg) const;
+
+        // 按编号直接索引的系统调用表. 普通函数直接调用, 其余可调用对象经 std::function 调用
+        struct SyscallSlot {
+            SyscallFunction function{};
+            VirtualMethod method{};
+            int arity = -1;     // 固定参数个数, -1 表示不限
+        };
+        std::array<SyscallSlot, SyscallCount> _syscalls{};
+        bool _syscalls_checked = false;
+
+        // 输出缓冲, 超过阈值时交给输出函数; 输出函数为空时写入标准输出
+        std::string _output{};
+        size_t _output_limit = DefaultOutputBuffer;
+        OutputWriter _output_writer{};
+
+        bool RegisterSyscall(int id, SyscallFunction function, int arity);
+        void CheckSyscalls();
+
+        void Syscall(uint8_t id, long site);
+
+        int RunSwitch(long start, uint64_t budget);
+        int RunThreaded(long start, uint64_t budget);
+        int RunJit(long start, uint64_t budget);
+        int RunProfiled(long start, uint64_t budget);
+        int RunTraced(long start, uint64_t budget);
+        int Run(long start, uint64_t budget);
 
+        public:
+            VirtualMachine();
+            ~VirtualMachine();
+            VirtualMachine(const VirtualMachine&) = delete;
+            VirtualMachine& operator=(const VirtualMachine&) = delete;
+
+            // 编号范围 1-255, 0 保留
             bool RegisterSyscall(int id, const VirtualMethod &method);
+
+            // 绑定普通函数, 由参数类型生成解码操作数的跳板函数, 非 void 返回值写入 R0.
+            // 首个参数可以是 VirtualMachine*; 参数个数在执行前对照程序中的每处调用检查一次
+            template<auto Function>
+            bool RegisterSyscall(int id);
+
+            bool HasSyscall(int id) const;
             int Execute(const std::string& table = "main");
+
+            // 至少执行 budget 条指令后在下一次跳转处暂停并返回 StatusYielded, 寄存器与 PC 保持不变.
+            // 预算只在跳转时检查, 不含跳转的一段代码最多超出预算一个程序长度
+            int Execute(const std::string& table, uint64_t budget);
+            int Resume(uint64_t budget = Unlimited);
+            bool IsYielded() const { return _status == StatusYielded; }
+
+            // 由系统调用处理函数调用: 当前 SYS 完成后挂起并返回 StatusSuspended.
+            // 宿主在异步操作完成后写入结果 (例如 SetRegisterValue), 再调用 Resume 从下一条指令继续
+            void Suspend() { _stop_request = StopRequest::Suspend; }
+            bool IsSuspended() const { return _status == StatusSuspended; }
+
+            // 解码当前程序并执行加载期优化, Execute 会在需要时自动调用
+            void Prepare();
+
+            // 设置输出函数与缓冲阈值, buffer 为 0 时每次输出立即写出.
+            // 执行到末尾、halt、退出或抛出异常时自动写出, 暂停与挂起时保留在缓冲区中
+            void SetOutput(OutputWriter writer, size_t buffer = DefaultOutputBuffer);
+            void Print(std::string_view text);
+            void FlushOutput();
+
+            // 结束当前执行并记录退出码, 供系统调用使用; Execute 随后返回 StatusHalt
+            void Exit(int code) { _exit_code = code; _stop_request = StopRequest::Exit; }
+            int GetExitCode() const { return _exit_code; }
+
+            // 暂停或挂起时为恢复位置
+            long GetProgramCounter() const { return _program_counter; }
+
+            uint64_t GetInstructionCount() const { return _retired; }
+            void ResetInstructionCount() { _retired = 0; }
+
+            void SetDispatchMode(const DispatchMode mode) { _dispatch_mode = mode; }
+            DispatchMode GetDispatchMode() const { return _dispatch_mode; }
+
+            void SetFusionEnabled(const bool enabled) { _fusion_enabled = enabled; _dirty = true; }
+            bool IsFusionEnabled() const { return _fusion_enabled; }
+            const std::vector<FusionStat>& GetFusionStats() const { return _program->GetFusionStats(); }
+
+            // 启用后热点区域被编译为本地代码, 平台不支持时返回 false 并保持解释执行
+            bool SetJitEnabled(bool enabled);
+            bool IsJitEnabled() const { return _jit != nullptr; }
+            void SetJitThreshold(const uint32_t threshold) { _jit_threshold = std::max<uint32_t>(threshold, 1); _dirty = true; }
+            uint32_t GetJitThreshold() const { return _jit_threshold; }
+
+            // 统计每条指令与每种指令的执行次数及系统调用耗时, 剖析期间不融合也不使用 JIT.
+            // 构建时未开启 VMASM_PROFILE 时返回 false
+            bool SetProfilingEnabled(bool enabled);
+            bool IsProfilingEnabled() const { return _profile != nullptr; }
+            const Profile *GetProfile() const { return _profile.get(); }
+            void ResetProfile();
+
+            // 记录最近 capacity 条指令的执行情况, 跟踪期间不融合、不使用 JIT, 优先于剖析.
+            // path 非空时在 halt、退出或抛出异常时自动写入该文件
+            void StartTrace(size_t capacity = DefaultTraceCapacity, const std::string &path = "");
+            // 停止记录, 缓冲区保留到下次 StartTrace, 仍可查看或写出
+            void StopTrace();
+            bool IsTracing() const { return _tracing; }
+            const TraceBuffer *GetTrace() const { return _trace.get(); }
+            bool DumpTrace(const std::string &path);
+
             void AddInstruction(const Instruction& instruction);
             void SetRegisterValue(uint8_t register_index, const Value& value);
+            void SetRegisterValue(uint8_t register_index, long value);
             Value GetRegisterValue(uint8_t register_index);
 
-            void SetInstructions(const std::list<Instruction> &instructions) { _instructions = instructions; }
-            std::list<Instruction>& GetInstructions() { return _instructions; }
+            // 快照: Save/Swap/Clear 作用于栈顶快照, Push/Pop 保存与恢复嵌套状态, 均不复制寄存器
+            void SaveSnapshot();
+            void SwapSnapshot();
+            void ClearSnapshot();
+            void ClearRegisters();
+            void PushSnapshot();
+            bool PopSnapshot();
+            size_t GetSnapshotDepth() const { return _snapshots.size() - 1; }
+
+            // 挂载共享的程序, 寄存器与快照保持不变
+            void Attach(std::shared_ptr<const Program> program);
+            // 返回当前程序, 有未完成的构建时先生成
+            const std::shared_ptr<const Program>& GetProgram() { Prepare(); return _program; }
+
+            void SetInstructions(const std::vector<Instruction> &instructions) { Edit().instructions = instructions; }
+            void SetInstructions(std::vector<Instruction> &&instructions) { Edit().instructions = std::move(instructions); }
+            const std::vector<Instruction>& GetInstructions() const { return _building ? _builder.instructions : _program->GetInstructions(); }
+
+            void SetTables(const std::unordered_map<std::string, long>& tables) { Edit().tables = tables; }
+            void SetTables(std::unordered_map<std::string, long>&& tables) { Edit().tables = std::move(tables); }
+            const std::unordered_map<std::string, long>& GetTables() const { return _building ? _builder.tables : _program->GetTables(); }
+    };
+}
 
-            void SetTables(const std::unordered_map<std::string, long>& tables) { _tables = tables; }
-            std::unordered_map<std::string, long>& GetTables() { return _tables; }
+inline const VMAsm::SyscallOperand &VMAsm::SyscallArgs::Operand(const size_t index) const {
+    if (index >= _size) throw std::out_of_range("Syscall argument index out of range");
+    return _operands[index];
+}
+
+inline long VMAsm::SyscallArgs::GetLong(const size_t index) const {
+    const SyscallOperand &operand = Operand(index);
+    return operand.is_reg ? _vm->ReadLong(_vm->_regs[operand.value]) : operand.value;
+}
+
+inline double VMAsm::SyscallArgs::GetDouble(const size_t index) const {
+    // 浮点数与整数共用 8 字节表示
+    const long bits = GetLong(index);
+    double value;
+    std::memcpy(&value, &bits, sizeof(double));
+    return value;
+}
+
+template<typename T>
+T VMAsm::SyscallArgs::Get(const size_t index) const {
+    using Type = std::decay_t<T>;
+    if constexpr (std::is_same_v<Type, bool>) return GetLong(index) != 0;
+    else if constexpr (std::is_integral_v<Type>) return static_cast<Type>(GetLong(index));
+    else if constexpr (std::is_floating_point_v<Type>) return static_cast<Type>(GetDouble(index));
+    else if constexpr (std::is_same_v<Type, std::string_view>) return GetString(index);
+    else if constexpr (std::is_same_v<Type, std::string>) return std::string(GetString(index));
+    else {
+        static_assert(std::is_same_v<Type, ByteSpan>, "Unsupported syscall parameter type");
+        return GetBytes(index);
+    }
+}
+
+namespace VMAsm {
+    // 由函数签名生成系统调用跳板: 第 i 个参数按声明类型读取第 i 个操作数
+    template<typename Signature>
+    struct SyscallBinding;
+
+    template<typename Result, typename... Args>
+    struct SyscallBinding<Result (*)(Args...)> {
+        typedef Result ResultType;
+        typedef std::index_sequence_for<Args...> Indices;
+        static constexpr int Arity = sizeof...(Args);
+
+        template<auto Function, size_t... I>
+        static Result Invoke(VirtualMachine *, const SyscallArgs &args, std::index_sequence<I...>) {
+            return Function(args.Get<Args>(I)...);
+        }
     };
+
+    template<typename Result, typename... Args>
+    struct SyscallBinding<Result (*)(VirtualMachine *, Args...)> {
+        typedef Result ResultType;
+        typedef std::index_sequence_for<Args...> Indices;
+        static constexpr int Arity = sizeof...(Args);
+
+        template<auto Function, size_t... I>
+        static Result Invoke(VirtualMachine *vm, const SyscallArgs &args, std::index_sequence<I...>) {
+            return Function(vm, args.Get<Args>(I)...);
+        }
+    };
+
+    template<auto Function>
+    void SyscallTrampoline(VirtualMachine *vm, const SyscallArgs &args) {
+        typedef SyscallBinding<decltype(Function)> Binding;
+        typedef typename Binding::ResultType Result;
+
+        if constexpr (std::is_void_v<Result>) {
+            Binding::template Invoke<Function>(vm, args, typename Binding::Indices{});
+        } else {
+            const Result result = Binding::template Invoke<Function>(vm, args, typename Binding::Indices{});
+            if constexpr (std::is_integral_v<Result>) {
+                vm->SetRegisterValue(0, static_cast<long>(result));
+            } else if constexpr (std::is_floating_point_v<Result>) {
+                const auto value = static_cast<double>(result);
+                long bits;
+                std::memcpy(&bits, &value, sizeof(long));
+                vm->SetRegisterValue(0, bits);
+            } else {
+                static_assert(std::is_convertible_v<Result, std::string_view>, "Unsupported syscall result type");
+                Value value;
+                vm->SetRegisterValue(0, *value.write(std::string(std::string_view(result))));
+            }
+        }
+    }
+}
+
+template<auto Function>
+bool VMAsm::VirtualMachine::RegisterSyscall(const int id) {
+    return RegisterSyscall(id, &SyscallTrampoline<Function>, SyscallBinding<decltype(Function)>::Arity);
 }
 
 template<>
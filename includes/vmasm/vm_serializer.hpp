@@ -30,7 +30,7 @@
 #pragma once
 
 #include <cstdint>
-#include <list>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -40,27 +40,46 @@ namespace VMAsm {
     struct Value;
     struct Instruction;
     class VirtualMachine;
+    class Program;
 
     class VMSerializer {
         public:
-            static bool SaveToFile(const std::list<Instruction>& instructions, const std::unordered_map<std::string, long>& tables,
+            static bool SaveToFile(const std::vector<Instruction>& instructions, const std::unordered_map<std::string, long>& tables,
                                    const std::string& filename);
             static bool SaveToFile(VirtualMachine * vm, const std::string& filename);
             static bool LoadFromFile(VirtualMachine *vm, const std::string& filename);
 
+            // 共享程序映像的保存与加载, 加载失败时返回 nullptr.
+            // 加载时字节码经过 Verifier 校验, 格式损坏或校验失败时抛出 std::runtime_error
+            static bool SaveToFile(const Program& program, const std::string& filename);
+            static std::shared_ptr<const Program> LoadProgram(const std::string& filename);
+
         private:
+            // 字节码格式版本, 0x02 起操作数标志字节中同时记录 is_table
+            static constexpr char FormatVersion = 0x02;
+            static constexpr uint8_t FlagRegister = 0x01;
+            static constexpr uint8_t FlagTable = 0x02;
+
+            static bool Load(const std::string& filename, std::vector<Instruction>& instructions,
+                             std::unordered_map<std::string, long>& tables);
+
+            static void BindReferences(std::vector<Instruction>& instructions,
+                                       const std::unordered_map<std::string, long>& tables, char version);
 
             static void WriteSizedData(std::ofstream &file, const void *data, uint32_t size);
-            static std::vector<uint8_t> ReadSizedData(std::ifstream &file);
+            // remaining 为文件中尚未读取的字节数, 长度字段超过它时在分配内存之前报错
+            static std::vector<uint8_t> ReadSizedData(std::ifstream &file, uint64_t &remaining);
 
             static void SerializeTables(const std::unordered_map<std::string, long> &tables, std::ofstream &file);
-            static std::unordered_map<std::string, long> DeserializeTables(std::ifstream &file, uint32_t num_tables);
+            static std::unordered_map<std::string, long> DeserializeTables(std::ifstream &file, uint32_t num_tables,
+                                                                           uint64_t &remaining);
 
             static void SerializeValue(const Value& value, std::vector<uint8_t>& buffer);
             static void SerializeInstruction(const Instruction& instr, std::vector<uint8_t>& buffer);
 
-            static Value DeserializeValue(const uint8_t*& data);
-            static Instruction DeserializeInstruction(const uint8_t*& data);
+            // 读取越过 end 时抛出异常
+            static Value DeserializeValue(const uint8_t*& data, const uint8_t* end);
+            static Instruction DeserializeInstruction(const uint8_t*& data, const uint8_t* end);
     };
 
 }
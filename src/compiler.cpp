@@ -30,29 +30,133 @@
 #include "vmasm/compiler.hpp"
 
 #include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstring>
 #include <fstream>
 #include <iostream>
-#include <sstream>
 
+#include "vmasm/verifier.hpp"
 #include "vmasm/vm.hpp"
 #include "vmasm/vm_serializer.hpp"
 
+namespace {
+
+    // 与 std::isspace / std::isdigit 在 "C" 区域下的结果相同, 但不查区域表
+    bool IsSpace(const char c) {
+        return c == ' ' || (c >= '\t' && c <= '\r');
+    }
+
+    bool IsDigit(const char c) {
+        return c >= '0' && c <= '9';
+    }
+
+    // 词法分析的字符分类: 普通字符可以连续吞入同一个 token, 其余字符需要逐个判断
+    constexpr std::array<bool, 256> BuildPlainTable() {
+        std::array<bool, 256> table{};
+        for (int c = 0; c < 256; ++c) {
+            table[c] = !(c == ' ' || (c >= '\t' && c <= '\r') || c == ',' || c == '"' || c == '[' || c == '/');
+        }
+        return table;
+    }
+
+    constexpr std::array<bool, 256> PlainChars = BuildPlainTable();
+
+    bool IsPlain(const char c) {
+        return PlainChars[static_cast<unsigned char>(c)];
+    }
+
+    constexpr char Lower(const char c) {
+        return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+    }
+
+    // 以 '\0' 结尾写入字符串操作数, 与 Value::write(const std::string&) 的布局相同, 省去临时字符串
+    void WriteText(VMAsm::Value &value, const std::string_view text) {
+        value.data.resize(text.size() + 1);
+        std::memcpy(value.data.data(), text.data(), text.size());
+        value.data[text.size()] = 0;
+    }
+
+    struct Mnemonic {
+        std::string_view name{};
+        VMAsm::OpCode code{};
+    };
+
+    constexpr Mnemonic Mnemonics[] = {
+        {"nop", VMAsm::OpCode::NOP}, {"jmp", VMAsm::OpCode::JMP}, {"mov", VMAsm::OpCode::MOV},
+        {"add", VMAsm::OpCode::ADD}, {"sub", VMAsm::OpCode::SUB}, {"neg", VMAsm::OpCode::NEG},
+        {"snap_save", VMAsm::OpCode::SNAP_SAVE}, {"snap_swap", VMAsm::OpCode::SNAP_SWAP},
+        {"snap_clear", VMAsm::OpCode::SNAP_CLEAR}, {"regs_clear", VMAsm::OpCode::REGS_CLEAR},
+        {"snap_push", VMAsm::OpCode::SNAP_PUSH}, {"snap_pop", VMAsm::OpCode::SNAP_POP},
+        {"jz", VMAsm::OpCode::JZ}, {"jnz", VMAsm::OpCode::JNZ}, {"jg", VMAsm::OpCode::JG}, {"jl", VMAsm::OpCode::JL},
+        {"halt", VMAsm::OpCode::HALT}, {"sys", VMAsm::OpCode::SYS},
+    };
+
+    // 助记符的完美哈希: 首字符、末字符与长度的组合在上表中互不冲突 (由 static_assert 保证).
+    // 命中槽位后再做一次不区分大小写的比较, 排除表外的单词
+    constexpr size_t MnemonicSlots = 32;
+
+    constexpr size_t MnemonicHash(const std::string_view name) {
+        return (static_cast<unsigned char>(Lower(name.front())) * 2 +
+                static_cast<unsigned char>(Lower(name.back())) * 25 + name.size()) % MnemonicSlots;
+    }
+
+    constexpr std::array<Mnemonic, MnemonicSlots> BuildMnemonicTable() {
+        std::array<Mnemonic, MnemonicSlots> table{};
+        for (const Mnemonic &mnemonic : Mnemonics) table[MnemonicHash(mnemonic.name)] = mnemonic;
+        return table;
+    }
+
+    constexpr std::array<Mnemonic, MnemonicSlots> MnemonicTable = BuildMnemonicTable();
+
+    constexpr bool IsPerfectHash() {
+        for (const Mnemonic &mnemonic : Mnemonics) {
+            if (MnemonicTable[MnemonicHash(mnemonic.name)].name != mnemonic.name) return false;
+        }
+        return true;
+    }
+
+    static_assert(IsPerfectHash(), "mnemonic hash collides, adjust MnemonicHash");
+
+    bool FindMnemonic(const std::string_view token, VMAsm::OpCode &code) {
+        if (token.empty()) return false;
+
+        const Mnemonic &slot = MnemonicTable[MnemonicHash(token)];
+        if (slot.name.size() != token.size()) return false;
+        for (size_t i = 0; i < token.size(); ++i) {
+            if (Lower(token[i]) != slot.name[i]) return false;
+        }
+        code = slot.code;
+        return true;
+    }
+
+}
+
 bool VMAsm::Compiler::CompileString(const std::string &context, VirtualMachine *vm) {
     _labels.clear();
     _tables.clear();
+    _entries.clear();
     _instructions.clear();
 
     ParseString(context);
 
-    ResolveReferences();
     GenerateTables();
+    ResolveReferences();
+    Verifier::Verify(_instructions, _tables);
+    Optimize();
 
-    vm->SetInstructions(std::list(_instructions.begin(), _instructions.end()));
-    vm->SetTables(_tables);
+    vm->SetInstructions(std::move(_instructions));
+    vm->SetTables(std::move(_tables));
 
     return true;
 }
 
+std::shared_ptr<const VMAsm::Program> VMAsm::Compiler::CompileString(const std::string &context) {
+    VirtualMachine vm;
+    CompileString(context, &vm);
+    return vm.GetProgram();
+}
+
 bool VMAsm::Compiler::CompileString(const std::string &context, const std::string &outPath) {
     VirtualMachine vm;
     CompileString(context, &vm);
@@ -63,154 +167,158 @@ bool VMAsm::Compiler::Compile(const std::vector<std::string>& sources, VirtualMa
     // 重置状态
     _labels.clear();
     _tables.clear();
+    _entries.clear();
     _instructions.clear();
     _source_files = sources;
 
     ParseFiles(sources);
 
     // 分析与生成阶段
-    ResolveReferences();
     GenerateTables();
+    ResolveReferences();
+    Verifier::Verify(_instructions, _tables);
+    Optimize();
 
     // 输出到虚拟机
-    vm->SetInstructions(std::list(_instructions.begin(), _instructions.end()));
-    vm->SetTables(_tables);
+    vm->SetInstructions(std::move(_instructions));
+    vm->SetTables(std::move(_tables));
     return true;
 }
 
+std::shared_ptr<const VMAsm::Program> VMAsm::Compiler::Compile(const std::vector<std::string> &sources) {
+    VirtualMachine vm;
+    Compile(sources, &vm);
+    return vm.GetProgram();
+}
+
 bool VMAsm::Compiler::Compile(const std::vector<std::string> &sources, const std::string &outPath) {
     VirtualMachine vm;
     Compile(sources, &vm);
     return VMSerializer::SaveToFile(&vm, outPath);
 }
 
-void VMAsm::Compiler::ProcessLine(std::string line, const size_t file_idx, const int line_num, bool &in_comment_block) {
-    line = Trim(line);
-
-    if (const size_t block_start = line.find("/*"); block_start != std::string::npos) {
-        in_comment_block = true;
-        line = line.substr(0, block_start);
-    }
+void VMAsm::Compiler::ParseSource(const std::string_view source, const size_t file_idx) {
+    bool in_comment_block = false;
+    int line_num = 0;
+    _instructions.reserve(_instructions.size() + std::count(source.begin(), source.end(), '\n') + 1);
 
-    if (in_comment_block) {
-        if (const size_t block_end = line.find("*/"); block_end != std::string::npos) {
-            in_comment_block = false;
-            line = line.substr(block_end + 2);
-        } else {
-            return;
-        }
-    }
+    // 单遍扫描整个缓冲区, 按行切分后直接在原缓冲区上分词
+    for (size_t pos = 0; pos < source.size();) {
+        size_t end = source.find('\n', pos);
+        if (end == std::string_view::npos) end = source.size();
 
-    if (const size_t comment_pos = line.find("//"); comment_pos != std::string::npos) {
-        line = line.substr(0, comment_pos);
+        Tokenize(source.substr(pos, end - pos), in_comment_block, _tokens);
+        ProcessLine(_tokens, file_idx, ++line_num);
+        pos = end + 1;
     }
+}
 
-    line = Trim(line);
-    if (line.empty()) return;
+void VMAsm::Compiler::ProcessLine(const std::vector<std::string_view> &tokens, const size_t file_idx, const int line_num) {
+    if (tokens.empty()) return;
 
-    if (line.find("#table") == 0) {
-        const auto tokens = Tokenize(line.substr(6));
-        if (tokens.size() != 1) {
+    if (const std::string_view first = tokens.front(); first.compare(0, 6, "#table") == 0) {
+        // "#table" 与表名之间可以没有空白
+        const std::string_view name = first.size() > 6 ? first.substr(6) : tokens.size() > 1 ? tokens[1] : "";
+        if (name.empty() || tokens.size() != (first.size() > 6 ? 1 : 2)) {
             throw std::runtime_error("Invalid table definition syntax");
         }
-        _tables[ToLower(tokens[0])] = 0;
+        _tables[ToLower(name)] = 0;
+        _entries.insert(ToLower(name));
         return;
     }
 
-    if (line.back() == ':') {
-        const std::string label = ToLower(line.substr(0, line.size() - 1));
-        _labels[label] = {_instructions.size(), file_idx, line_num};
+    // 以 ':' 结尾的行是标签, 标签名为冒号之前的全部内容
+    if (const std::string_view last = tokens.back(); last.back() == ':' && !IsStringLiteral(last) && !IsByteArray(last)) {
+        const char *begin = tokens.front().data();
+        const std::string_view label = Trim({begin, static_cast<size_t>(last.data() + last.size() - 1 - begin)});
+        _labels[ToLower(label)] = {_instructions.size(), file_idx, line_num};
         return;
     }
 
     try {
-        _instructions.push_back(ParseInstruction(line, file_idx, line_num));
+        _instructions.push_back(ParseInstruction(tokens));
     } catch (const std::exception& e) {
         throw std::runtime_error(e.what());
     }
 }
 
 bool VMAsm::Compiler::ParseString(const std::string &source) {
-    std::istringstream iss(source);
-    std::string line;
-    int line_num = 0;
-    bool in_comment_block = false;
-
-    while (std::getline(iss, line)) {
-        ++line_num;
-        ProcessLine(line, -1, line_num, in_comment_block);
-    }
-
+    ParseSource(source, -1);
     return true;
 }
 
 bool VMAsm::Compiler::ParseFiles(const std::vector<std::string>& sources) {
+    std::string buffer;
     for (size_t file_idx = 0; file_idx < sources.size(); ++file_idx) {
-        std::ifstream file(sources[file_idx]);
+        std::ifstream file(sources[file_idx], std::ios::binary);
         if (!file.is_open()) {
             throw std::runtime_error("Unable to open a file: " + sources[file_idx]);
         }
 
-        std::string line;
-        int line_num = 0;
-        bool in_comment_block = false;
+        // 整个文件一次读入
+        file.seekg(0, std::ios::end);
+        buffer.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0, std::ios::beg);
+        file.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
 
-        while (std::getline(file, line)) {
-            ++line_num;
-            ProcessLine(line, file_idx, line_num, in_comment_block);
-        }
+        ParseSource(buffer, file_idx);
     }
     return true;
 }
 
 void VMAsm::Compiler::ResolveReferences() {
+    // 所有符号引用在此绑定为指令下标, 执行时跳转只需读取一个整数.
+    // 绑定后的引用保留 is_table 标记, 表示该值是代码地址
+    std::string name;
     for (auto&[code, Args] : _instructions) {
-        for (auto arg : Args) {
-            if (!arg.is_reg && !arg.is_table) {
-                if (auto ref = arg.to<std::string>(); _labels.count(ToLower(ref))) arg.write(static_cast<long>(_labels[ToLower(ref)].instruction_index));
-                else if (_tables.count(ToLower(ref))) {
-                    arg.is_table = true;
-                    arg.write("#" + ref);
-                }
+        for (auto& arg : Args) {
+            if (!arg.is_table) continue;
+
+            // "#name" 必须能解析; 裸标识符只有在匹配标签或表时才视为引用, 否则保留为字符串
+            std::string_view ref(reinterpret_cast<const char *>(arg.data.data()), arg.data.size());
+            ref = ref.substr(0, ref.find('\0'));
+            const bool explicit_ref = !ref.empty() && ref[0] == '#';
+            if (explicit_ref) ref.remove_prefix(1);
+
+            name.resize(ref.size());
+            std::transform(ref.begin(), ref.end(), name.begin(), Lower);
+
+            if (const auto it = _tables.find(name); it != _tables.end()) {
+                arg.write(it->second);
+            } else if (explicit_ref) {
+                throw std::runtime_error("Undefined table: " + name);
+            } else {
+                arg.is_table = false;
             }
         }
     }
 }
 
+void VMAsm::Compiler::Optimize() {
+    // 在校验之后运行, 优化过程可以假定操作数数量与寄存器下标均合法
+    Optimizer optimizer(_optimization_level);
+    for (const auto &rule : _peephole_rules) optimizer.AddRule(rule);
+    optimizer.Run(_instructions, _tables, _entries);
+    _optimizer_stats = optimizer.GetStats();
+
+    // 删除指令后标签随表一起移动
+    for (auto &[label, info] : _labels) info.instruction_index = _tables[label];
+}
+
 void VMAsm::Compiler::GenerateTables() {
+    _tables.reserve(_tables.size() + _labels.size());
     for (const auto& [label, info] : _labels) {
         _tables[label] = static_cast<long>(info.instruction_index);
     }
 }
 
-VMAsm::Instruction VMAsm::Compiler::ParseInstruction(const std::string &line, size_t file_idx, int line_num) {
-    const auto tokens = Tokenize(line);
-    if (tokens.empty()) {
-        throw std::runtime_error("Null instructions");
-    }
-
+VMAsm::Instruction VMAsm::Compiler::ParseInstruction(const std::vector<std::string_view> &tokens) {
     Instruction instr;
-
-    if (const std::string opcode = ToLower(tokens[0]); opcode == "nop") instr.code = OpCode::NOP;
-    else if (opcode == "jmp") instr.code = OpCode::JMP;
-    else if (opcode == "mov") instr.code = OpCode::MOV;
-    else if (opcode == "add") instr.code = OpCode::ADD;
-    else if (opcode == "sub") instr.code = OpCode::SUB;
-    else if (opcode == "neg") instr.code = OpCode::NEG;
-    else if (opcode == "snap_save") instr.code = OpCode::SNAP_SAVE;
-    else if (opcode == "snap_swap") instr.code = OpCode::SNAP_SWAP;
-    else if (opcode == "snap_clear") instr.code = OpCode::SNAP_CLEAR;
-    else if (opcode == "regs_clear") instr.code = OpCode::REGS_CLEAR;
-    else if (opcode == "jz") instr.code = OpCode::JZ;
-    else if (opcode == "jnz") instr.code = OpCode::JNZ;
-    else if (opcode == "jg") instr.code = OpCode::JG;
-    else if (opcode == "jl") instr.code = OpCode::JL;
-    else if (opcode == "halt") instr.code = OpCode::HALT;
-    else if (opcode == "sys") instr.code = OpCode::SYS;
-    else {
-        throw std::runtime_error("Unknown opcodes:" + tokens[0]);
+    if (!FindMnemonic(tokens.front(), instr.code)) {
+        throw std::runtime_error("Unknown opcodes:" + std::string(tokens.front()));
     }
 
+    instr.Args.reserve(tokens.size() / 2);
     for (size_t i = 1; i < tokens.size(); ++i) {
         if (tokens[i] != ",") {
             instr.Args.push_back(ParseValue(tokens[i]));
@@ -220,133 +328,148 @@ VMAsm::Instruction VMAsm::Compiler::ParseInstruction(const std::string &line, si
     return instr;
 }
 
-VMAsm::Value VMAsm::Compiler::ParseValue(const std::string& token) {
+VMAsm::Value VMAsm::Compiler::ParseValue(const std::string_view token) {
     Value val { false, false };
 
     if (IsRegister(token)) {
-        const std::string reg_num_str = ToLower(token).substr(1);
-        const auto reg_index = static_cast<uint8_t>(std::stoi(reg_num_str));
-        if (reg_index >= 64) {
-            throw std::runtime_error("Register index out of range (0-63): " + token);
+        const long reg_index = ParseInteger(token.substr(1));
+        if (reg_index < 0 || reg_index >= 64) {
+            throw std::runtime_error("Register index out of range (0-63): " + std::string(token));
         }
         val.is_reg = true;
-        val.write(reg_index);
+        val.write(static_cast<uint8_t>(reg_index));
         return val;
     }
 
     if (IsTableRef(token)) {
         val.is_table = true;
-        val.write(token.substr(1));
+        WriteText(val, token);
         return val;
     }
 
     if (IsByteArray(token)) {
-        const auto bytes = ParseByteArray(token);
-        val.write_container(bytes);
+        val.data = ParseByteArray(token);
         return val;
     }
 
     if (IsStringLiteral(token)) {
-        const std::string str = UnescapeString(token.substr(1, token.size() - 2));
-        val.write(str);
+        // 没有转义时直接引用源码中的内容
+        if (const std::string_view body = token.substr(1, token.size() - 2); body.find('\\') == std::string_view::npos) {
+            WriteText(val, body);
+        } else {
+            val.write(UnescapeString(body));
+        }
         return val;
     }
 
     if (IsFloat(token)) {
-        const double num = std::stod(token);
+        // from_chars 不接受前导 '+'
+        const std::string_view digits = token.front() == '+' ? token.substr(1) : token;
+        double num;
+        std::from_chars(digits.data(), digits.data() + digits.size(), num);
         val.write(num);
         return val;
     }
 
     if (IsInteger(token)) {
-        const long num = std::stol(token);
+        const long num = ParseInteger(token);
         val.write(num);
         return val;
     }
 
-    val.write(token);
+    // 裸标识符可能是标签引用, 由 ResolveReferences 决定
+    val.is_table = true;
+    WriteText(val, token);
     return val;
 }
 
+void VMAsm::Compiler::Tokenize(const std::string_view line, bool &in_comment_block,
+                               std::vector<std::string_view> &tokens) {
+    tokens.clear();
+    const size_t size = line.size();
+    size_t start = std::string_view::npos;
+
+    auto flush = [&](const size_t end) {
+        if (start == std::string_view::npos) return;
+        tokens.push_back(line.substr(start, end - start));
+        start = std::string_view::npos;
+    };
+
+    for (size_t i = 0; i < size;) {
+        const char c = line[i];
+
+        if (in_comment_block) {
+            if (c == '*' && i + 1 < size && line[i + 1] == '/') {
+                in_comment_block = false;
+                i += 2;
+            } else {
+                ++i;
+            }
+            continue;
+        }
 
-std::vector<std::string> VMAsm::Compiler::Tokenize(const std::string& line) {
-    std::vector<std::string> tokens;
-    std::string token;
-    bool in_string = false;
-    bool in_array = false;
+        if (c == '/' && i + 1 < size && line[i + 1] == '/') {
+            // 行注释可以紧贴在 token 后面
+            flush(i);
+            return;
+        }
+
+        if (c == '/' && i + 1 < size && line[i + 1] == '*') {
+            flush(i);
+            in_comment_block = true;
+            i += 2;
+            continue;
+        }
 
-    for (const char c : line) {
-        if (in_string) {
+        if (c == '"' || c == '[') {
+            // 字符串到下一个未转义的引号为止, 字节数组到 ']' 为止; 未闭合时取到行尾
+            flush(i);
+            size_t end = i + 1;
             if (c == '"') {
-                token += c;
-                tokens.push_back(token);
-                token.clear();
-                in_string = false;
-            } else {
-                token += c;
-            }
-        } else if (in_array) {
-            if (c == ']') {
-                token += c;
-                tokens.push_back(token);
-                token.clear();
-                in_array = false;
+                while (end < size && line[end] != '"') end += line[end] == '\\' ? 2 : 1;
             } else {
-                token += c;
-            }
-        } else {
-            if (isspace(c) || c == ',') {
-                if (!token.empty()) {
-                    tokens.push_back(token);
-                    token.clear();
-                }
-                if (c == ',') tokens.emplace_back(",");
-            } else if (c == '"') {
-                if (!token.empty()) {
-                    tokens.push_back(token);
-                    token.clear();
-                }
-                token += c;
-                in_string = true;
-            } else if (c == '[') {
-                if (!token.empty()) {
-                    tokens.push_back(token);
-                    token.clear();
-                }
-                token += c;
-                in_array = true;
-            } else {
-                token += c;
+                while (end < size && line[end] != ']') ++end;
             }
+            end = std::min(end + 1, size);
+            tokens.push_back(line.substr(i, end - i));
+            i = end;
+            continue;
         }
-    }
 
-    if (!token.empty()) {
-        tokens.push_back(token);
+        if (IsSpace(c) || c == ',') {
+            flush(i);
+            if (c == ',') tokens.push_back(line.substr(i, 1));
+            ++i;
+            continue;
+        }
+
+        if (start == std::string_view::npos) start = i;
+        ++i;
+        while (i < size && IsPlain(line[i])) ++i;
     }
 
-    return tokens;
+    flush(size);
 }
 
-bool VMAsm::Compiler::IsRegister(const std::string& token) {
+bool VMAsm::Compiler::IsRegister(const std::string_view token) {
     if (token.size() < 2) return false;
-    if (const auto first = tolower(token[0]); first != 'r') return false;
+    if (token[0] != 'r' && token[0] != 'R') return false;
     return IsInteger(token.substr(1));
 }
 
-bool VMAsm::Compiler::IsTableRef(const std::string& token) {
+bool VMAsm::Compiler::IsTableRef(const std::string_view token) {
     return !token.empty() && token[0] == '#';
 }
 
-bool VMAsm::Compiler::IsByteArray(const std::string& token) {
+bool VMAsm::Compiler::IsByteArray(const std::string_view token) {
     return token.size() >= 2 && token.front() == '[' && token.back() == ']';
 }
 
-bool VMAsm::Compiler::IsStringLiteral(const std::string& token) {
+bool VMAsm::Compiler::IsStringLiteral(const std::string_view token) {
     return token.size() >= 2 && token.front() == '"' && token.back() == '"';
 }
 
-bool VMAsm::Compiler::IsFloat(const std::string &token) {
+bool VMAsm::Compiler::IsFloat(const std::string_view token) {
     if (token.empty()) return false;
 
     size_t start = 0;
@@ -362,7 +485,7 @@ bool VMAsm::Compiler::IsFloat(const std::string &token) {
     for (size_t i = start; i < token.size(); ++i) {
         const char c = token[i];
 
-        if (isdigit(c)) {
+        if (IsDigit(c)) {
             digitSeen = true;
             continue;
         }
@@ -388,34 +511,47 @@ bool VMAsm::Compiler::IsFloat(const std::string &token) {
     return digitSeen && (hasDecimal || hasExponent);
 }
 
-bool VMAsm::Compiler::IsInteger(const std::string& token) {
+bool VMAsm::Compiler::IsInteger(const std::string_view token) {
     if (token.empty()) return false;
 
-    long start = 0;
+    size_t start = 0;
     if (token[0] == '+' || token[0] == '-') {
         start = 1;
         if (token.size() == 1) return false;
     }
 
-    return std::all_of(token.begin() + start, token.end(), ::isdigit);
+    return std::all_of(token.begin() + static_cast<long>(start), token.end(), IsDigit);
 }
 
-std::vector<uint8_t> VMAsm::Compiler::ParseByteArray(const std::string& token) {
+long VMAsm::Compiler::ParseInteger(const std::string_view token) {
+    const std::string_view digits = !token.empty() && token.front() == '+' ? token.substr(1) : token;
+
+    long value = 0;
+    const auto [end, error] = std::from_chars(digits.data(), digits.data() + digits.size(), value);
+    if (error != std::errc() || end != digits.data() + digits.size()) {
+        throw std::runtime_error("Invalid integer: " + std::string(token));
+    }
+    return value;
+}
+
+std::vector<uint8_t> VMAsm::Compiler::ParseByteArray(const std::string_view token) {
     std::vector<uint8_t> bytes;
-    const std::string content = token.substr(1, token.size() - 2);
-    std::istringstream iss(content);
-    std::string byte_str;
+    std::string_view content = token.substr(1, token.size() - 2);
 
-    while (std::getline(iss, byte_str, ',')) {
-        byte_str = Trim(byte_str);
+    while (!content.empty()) {
+        const size_t comma = content.find(',');
+        std::string_view byte_str = Trim(content.substr(0, comma));
+        content = comma == std::string_view::npos ? std::string_view() : content.substr(comma + 1);
         if (byte_str.empty()) continue;
 
-        if (byte_str.find("0x") == 0 || byte_str.find("0X") == 0) byte_str = byte_str.substr(2);
+        if (byte_str.compare(0, 2, "0x") == 0 || byte_str.compare(0, 2, "0X") == 0) byte_str.remove_prefix(2);
 
-        char* end;
-        const long byte = strtol(byte_str.c_str(), &end, 16);
-        if (*end != '\0') throw std::runtime_error("Invalid byte format: " + byte_str);
-        if (byte < 0 || byte > 255) throw std::runtime_error("Byte value out of range (0-255): " + byte_str);
+        long byte = 0;
+        const auto [end, error] = std::from_chars(byte_str.data(), byte_str.data() + byte_str.size(), byte, 16);
+        if (error != std::errc() || end != byte_str.data() + byte_str.size() || byte_str.empty()) {
+            throw std::runtime_error("Invalid byte format: " + std::string(byte_str));
+        }
+        if (byte < 0 || byte > 255) throw std::runtime_error("Byte value out of range (0-255): " + std::string(byte_str));
 
         bytes.push_back(static_cast<uint8_t>(byte));
     }
@@ -423,25 +559,23 @@ std::vector<uint8_t> VMAsm::Compiler::ParseByteArray(const std::string& token) {
     return bytes;
 }
 
-std::string VMAsm::Compiler::ToLower(std::string s) {
-    std::transform(s.begin(), s.end(), s.begin(), [](const unsigned char c) {
+std::string VMAsm::Compiler::ToLower(const std::string_view s) {
+    std::string result(s);
+    std::transform(result.begin(), result.end(), result.begin(), [](const unsigned char c) {
         return std::tolower(c);
     });
-    return s;
+    return result;
 }
 
-std::string VMAsm::Compiler::Trim(std::string s) {
-    s.erase(s.begin(), std::find_if(s.begin(), s.end(), [](const int ch) {
-        return !std::isspace(ch);
-    }));
-    s.erase(std::find_if(s.rbegin(), s.rend(), [](const int ch) {
-        return !std::isspace(ch);
-    }).base(), s.end());
+std::string_view VMAsm::Compiler::Trim(std::string_view s) {
+    while (!s.empty() && IsSpace(s.front())) s.remove_prefix(1);
+    while (!s.empty() && IsSpace(s.back())) s.remove_suffix(1);
     return s;
 }
 
-std::string VMAsm::Compiler::UnescapeString(const std::string &s) {
+std::string VMAsm::Compiler::UnescapeString(const std::string_view s) {
     std::string result;
+    result.reserve(s.size());
     bool escape = false;
 
     for (const char c : s) {
@@ -468,4 +602,4 @@ std::string VMAsm::Compiler::UnescapeString(const std::string &s) {
     }
 
     return result;
-}
\ No newline at end of file
+}
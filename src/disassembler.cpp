@@ -32,11 +32,13 @@
 #include <cmath>
 #include <iomanip>
 #include <iostream>
+#include <map>
 
 #include "vmasm/vm.hpp"
 
 #include <sstream>
 
+#include "vmasm/trace.hpp"
 #include "vmasm/vm_serializer.hpp"
 
 
@@ -53,8 +55,8 @@ std::string VMAsm::Disassembler::Disassemble(VirtualMachine* vm) {
     const auto& instructions = vm->GetInstructions();
 
     // 反汇编所有指令
-    for (const auto& instr : instructions) {
-        output << DisassembleInstruction(instr) << "\n";
+    for (size_t i = 0; i < instructions.size(); ++i) {
+        output << DisassembleInstruction(instructions[i], static_cast<long>(i)) << "\n";
     }
 
     // 输出表定义
@@ -67,15 +69,20 @@ std::string VMAsm::Disassembler::Disassemble(VirtualMachine* vm) {
     return output.str();
 }
 
-std::string VMAsm::Disassembler::DisassembleInstruction(const Instruction& instr) {
+std::string VMAsm::Disassembler::DisassembleInstruction(const Instruction& instr, const long index) {
     std::stringstream ss;
 
     // 检查当前地址是否是标签
-    static long instrIndex = 0;
-    if (_labelMap.count(instrIndex)) {
-        ss << _labelMap[instrIndex] << ":\n";
+    if (_labelMap.count(index)) {
+        ss << _labelMap[index] << ":\n";
     }
-    instrIndex++;
+
+    ss << DisassembleOperation(instr);
+    return ss.str();
+}
+
+std::string VMAsm::Disassembler::DisassembleOperation(const Instruction& instr) {
+    std::stringstream ss;
 
     // 反汇编操作码
     switch (instr.code) {
@@ -95,6 +102,9 @@ std::string VMAsm::Disassembler::DisassembleInstruction(const Instruction& instr
         case OpCode::SNAP_SWAP: ss << "    snap_swap"; break;
         case OpCode::SNAP_CLEAR: ss << "    snap_clear"; break;
         case OpCode::REGS_CLEAR: ss << "    regs_clear"; break;
+        case OpCode::SNAP_PUSH: ss << "    snap_push"; break;
+        case OpCode::SNAP_POP: ss << "    snap_pop"; break;
+        default: break;
     }
 
     // 反汇编参数
@@ -106,9 +116,53 @@ std::string VMAsm::Disassembler::DisassembleInstruction(const Instruction& instr
     return ss.str();
 }
 
+std::string VMAsm::Disassembler::DisassembleTrace(const std::string& trace_path, VirtualMachine* vm) {
+    TraceFile trace;
+    if (!TraceFile::Load(trace_path, trace)) throw std::runtime_error("Invalid trace file: " + trace_path);
+
+    const auto& instructions = vm->GetInstructions();
+    if (trace.instructions != instructions.size()) {
+        throw std::runtime_error("Trace was recorded from a program with " + std::to_string(trace.instructions) +
+                                 " instruction(s), got " + std::to_string(instructions.size()));
+    }
+
+    BuildReverseMaps(vm);
+
+    // 标签按下标排序, 用于把每条记录定位为 "标签+偏移"
+    std::map<long, std::string> labels(_labelMap.begin(), _labelMap.end());
+
+    std::stringstream output;
+    uint64_t sequence = trace.written - trace.records.size();
+    if (sequence != 0) output << "; " << sequence << " earlier record(s) overwritten\n";
+
+    for (const TraceRecord& record : trace.records) {
+        std::string location = std::to_string(record.pc);
+        if (auto it = labels.upper_bound(record.pc); it != labels.begin()) {
+            --it;
+            location = it->second + (record.pc == it->first ? "" : "+" + std::to_string(record.pc - it->first));
+        }
+
+        output << std::setw(10) << sequence++ << "  " << std::setw(6) << record.pc << "  "
+               << std::left << std::setw(16) << location << std::right;
+
+        std::string operation = record.pc < instructions.size() ? DisassembleOperation(instructions[record.pc]) : "    ?";
+        output << operation.substr(4);
+        if (record.reg != TraceNoRegister) {
+            output << "    ; R" << static_cast<int>(record.reg) << " = " << static_cast<long>(record.value);
+        }
+        output << "\n";
+    }
+
+    return output.str();
+}
+
 std::string VMAsm::Disassembler::ValueToString(const Value& val) {
     if (val.is_reg) return "R" + std::to_string(val.to<uint8_t>());
-    if (val.is_table) return "#" + val.to<std::string>();
+    if (val.is_table) {
+        const long addr = val.to<long>();
+        if (const auto it = _labelMap.find(addr); it != _labelMap.end()) return "#" + it->second;
+        return std::to_string(addr);
+    }
 
     if (val.data.size() == sizeof(double)) {
         double d;
@@ -178,21 +232,10 @@ std::string VMAsm::Disassembler::FormatDouble(const double d) {
 }
 
 void VMAsm::Disassembler::BuildReverseMaps(VirtualMachine* vm) {
-    // 构建标签反向映射
+    // 构建标签反向映射, 代码地址引用在编译时已绑定为下标, 通过它还原为标签名
     for (const auto& [name, addr] : vm->GetTables()) {
         _labelMap[addr] = name;
     }
-
-    // 构建表反向映射
-    size_t instrIndex = 0;
-    for (const auto&[code, Args] : vm->GetInstructions()) {
-        for (const auto& arg : Args) {
-            if (arg.is_table) {
-                _tableMap[arg.to<long>()] = arg.to<std::string>();
-            }
-        }
-        instrIndex++;
-    }
 }
 
 std::string VMAsm::Disassembler::FormatHex(const uint8_t byte) {
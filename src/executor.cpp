@@ -0,0 +1,165 @@
+/*******************************************************************************
+ * 文件名称: executor
+ * 项目名称: TEFModLoader
+ * 创建时间: 2026/10/16
+ * 作者: EternalFuture゙
+ * Github: https://github.com/eternalfuture-e38299
+ * 版权声明: Copyright © 2025 EternalFuture゙
+ * 
+ * MIT License
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+
+#include "vmasm/executor.hpp"
+
+#include <chrono>
+#include <exception>
+#include <stdexcept>
+
+#include "vmasm/syscalls.hpp"
+
+VMAsm::Executor::Executor(size_t threads) : _setup([](VirtualMachine &vm) { SysCallRegistry::Init(&vm); }) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (size_t i = 0; i < threads; ++i) _workers.push_back(std::make_unique<Worker>());
+    for (size_t i = 0; i < threads; ++i) _workers[i]->thread = std::thread(&Executor::WorkerLoop, this, i);
+}
+
+VMAsm::Executor::~Executor() {
+    {
+        std::lock_guard lock(_lock);
+        _stopping = true;
+    }
+    _wake.notify_all();
+    for (const auto &worker : _workers) worker->thread.join();
+}
+
+std::vector<VMAsm::JobResult> VMAsm::Executor::Run(const std::vector<Job> &jobs) {
+    std::vector<JobResult> results(jobs.size());
+    _stats = ExecutorStats{};
+    if (jobs.empty()) return results;
+
+    const auto begin = std::chrono::steady_clock::now();
+
+    // 先发布批次再填充队列: 上一批次尚未回到等待状态的线程也可能直接取到新任务
+    _jobs = &jobs;
+    _results = &results;
+    _instructions = 0;
+    _remaining = jobs.size();
+
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        Worker &worker = *_workers[i % _workers.size()];
+        std::lock_guard lock(worker.lock);
+        worker.queue.push_back(i);
+    }
+
+    {
+        std::lock_guard lock(_lock);
+        ++_generation;
+    }
+    _wake.notify_all();
+
+    {
+        std::unique_lock lock(_lock);
+        _done.wait(lock, [this] { return _remaining == 0; });
+    }
+
+    _stats.jobs = jobs.size();
+    _stats.instructions = _instructions;
+    _stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    return results;
+}
+
+void VMAsm::Executor::WorkerLoop(const size_t index) {
+    uint64_t seen = 0;
+    for (;;) {
+        {
+            std::unique_lock lock(_lock);
+            _wake.wait(lock, [&] { return _stopping || _generation != seen; });
+            if (_stopping) return;
+            seen = _generation;
+        }
+
+        size_t job;
+        while (Take(index, job)) Execute(job);
+    }
+}
+
+bool VMAsm::Executor::Take(const size_t index, size_t &job) {
+    // 自己的队列后进先出, 窃取时从队列头部取, 减少与队列主人的竞争
+    {
+        Worker &self = *_workers[index];
+        std::lock_guard lock(self.lock);
+        if (!self.queue.empty()) {
+            job = self.queue.back();
+            self.queue.pop_back();
+            return true;
+        }
+    }
+
+    for (size_t k = 1; k < _workers.size(); ++k) {
+        Worker &victim = *_workers[(index + k) % _workers.size()];
+        std::lock_guard lock(victim.lock);
+        if (!victim.queue.empty()) {
+            job = victim.queue.front();
+            victim.queue.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void VMAsm::Executor::Execute(const size_t job) {
+    const Job &task = (*_jobs)[job];
+    JobResult &result = (*_results)[job];
+
+    // 虚拟机在计数减少之前析构: Run 返回后调用方可能立即销毁 Setup 捕获的状态,
+    // 析构时的收尾工作不能与之交错
+    {
+        // 任务中的任何异常都只让这一个任务失败, 不能离开工作线程
+        VirtualMachine vm;
+        try {
+            if (!task.program) throw std::runtime_error("Job has no program");
+            if (_setup) _setup(vm);
+            if (_jit) vm.SetJitEnabled(true);
+            vm.Attach(task.program);
+
+            for (const auto &[reg, value] : task.registers) vm.SetRegisterValue(reg, value);
+            result.status = vm.Execute(task.entry);
+        } catch (const std::exception &e) {
+            result.failed = true;
+            result.error = e.what();
+        } catch (...) {
+            result.failed = true;
+            result.error = "Unknown exception";
+        }
+
+        result.exit_code = vm.GetExitCode();
+        result.instructions = vm.GetInstructionCount();
+        result.registers.reserve(RegisterCount);
+        for (size_t i = 0; i < RegisterCount; ++i) result.registers.push_back(vm.GetRegisterValue(static_cast<uint8_t>(i)));
+    }
+    _instructions += result.instructions;
+
+    if (--_remaining == 0) {
+        std::lock_guard lock(_lock);
+        _done.notify_all();
+    }
+}
@@ -0,0 +1,78 @@
+/*******************************************************************************
+ * 文件名称: format
+ * 项目名称: TEFModLoader
+ * 创建时间: 2026/10/16
+ * 作者: EternalFuture゙
+ * Github: https://github.com/eternalfuture-e38299
+ * 版权声明: Copyright © 2025 EternalFuture゙
+ * 
+ * MIT License
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+
+#include "vmasm/format.hpp"
+
+#include <stdexcept>
+
+VMAsm::Format VMAsm::Format::Parse(const std::string_view format) {
+    Format result;
+    result._text.reserve(format.size());
+
+    auto literal = [&result](const std::string_view text) {
+        if (text.empty()) return;
+
+        // 相邻的字面文本合并为一段
+        if (!result._pieces.empty() && result._pieces.back().spec == 0) {
+            result._pieces.back().length += static_cast<uint32_t>(text.size());
+        } else {
+            result._pieces.push_back({static_cast<uint32_t>(result._text.size()), static_cast<uint32_t>(text.size()), 0});
+        }
+        result._text.append(text);
+    };
+
+    size_t start = 0;
+    for (size_t i = 0; i < format.size(); ++i) {
+        // 末尾单独的 '%' 按字面输出
+        if (format[i] != '%' || i + 1 >= format.size()) continue;
+
+        literal(format.substr(start, i - start));
+        const char spec = format[++i];
+        start = i + 1;
+
+        switch (spec) {
+            case 'd':
+            case 'f':
+            case 's':
+            case 'c':
+            case 'x':
+                result._pieces.push_back({0, 0, spec});
+                result._arguments++;
+                break;
+            case '%':
+                literal("%");
+                break;
+            default:
+                throw std::runtime_error("Invalid format specifier: %" + std::string(1, spec));
+        }
+    }
+    literal(format.substr(start));
+
+    return result;
+}
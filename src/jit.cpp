@@ -0,0 +1,409 @@
+/*******************************************************************************
+ * 文件名称: jit
+ * 项目名称: TEFModLoader
+ * 创建时间: 2026/10/16
+ * 作者: EternalFuture゙
+ * Github: https://github.com/eternalfuture-e38299
+ * 版权声明: Copyright © 2025 EternalFuture゙
+ * 
+ * MIT License
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+
+#include "vmasm/jit.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_set>
+
+#include "vmasm/vm.hpp"
+
+#if VMASM_JIT_SUPPORTED
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+VMAsm::JitCompiler::~JitCompiler() {
+    Reset();
+}
+
+#if VMASM_JIT_SUPPORTED
+
+namespace {
+
+    // 寄存器槽布局: bits 位于 +0, size 与 tag 共同位于 +8 开始的 8 字节中
+    constexpr int32_t SlotSize = sizeof(VMAsm::Register);
+    constexpr int32_t TagOffset = offsetof(VMAsm::Register, tag);
+    constexpr int32_t MetaOffset = offsetof(VMAsm::Register, size);
+    static_assert(offsetof(VMAsm::Register, bits) == 0, "unexpected Register layout");
+    static_assert(MetaOffset == 8 && TagOffset == 12, "unexpected Register layout");
+
+    // 写入 8 字节整数后 +8 处的内容: size = 8, tag = Inline
+    constexpr uint64_t InlineLongMeta =
+        sizeof(long) | static_cast<uint64_t>(VMAsm::RegisterTag::Inline) << 32;
+
+    // rdi 固定指向寄存器文件, rsi 指向指令计数, rdx 为本次进入的指令预算,
+    // rax/rcx 为临时寄存器, r8 保存 InlineLongMeta, r9 累计本次进入区域后执行的指令数
+    class Emitter {
+        public:
+            std::vector<uint8_t> code{};
+
+            size_t Offset() const { return code.size(); }
+
+            void Bytes(std::initializer_list<uint8_t> bytes) { code.insert(code.end(), bytes); }
+
+            void Dword(const int32_t value) {
+                const auto *p = reinterpret_cast<const uint8_t*>(&value);
+                code.insert(code.end(), p, p + sizeof(value));
+            }
+
+            void Qword(const uint64_t value) {
+                const auto *p = reinterpret_cast<const uint8_t*>(&value);
+                code.insert(code.end(), p, p + sizeof(value));
+            }
+
+            static int32_t Slot(const long reg) { return static_cast<int32_t>(reg) * SlotSize; }
+            static bool FitsInt32(const long value) { return value >= INT32_MIN && value <= INT32_MAX; }
+
+            void MovRaxImm(const long value) {
+                if (FitsInt32(value)) { Bytes({0x48, 0xC7, 0xC0}); Dword(static_cast<int32_t>(value)); }
+                else { Bytes({0x48, 0xB8}); Qword(static_cast<uint64_t>(value)); }
+            }
+
+            void MovRcxImm(const long value) { Bytes({0x48, 0xB9}); Qword(static_cast<uint64_t>(value)); }
+            void MovR8Imm(const uint64_t value) { Bytes({0x49, 0xB8}); Qword(value); }
+
+            void LoadRax(const long reg) { Bytes({0x48, 0x8B, 0x87}); Dword(Slot(reg)); }
+            void LoadRcx(const long reg, const int32_t offset) { Bytes({0x48, 0x8B, 0x8F}); Dword(Slot(reg) + offset); }
+            void StoreRax(const long reg) { Bytes({0x48, 0x89, 0x87}); Dword(Slot(reg)); }
+            void StoreRcx(const long reg, const int32_t offset) { Bytes({0x48, 0x89, 0x8F}); Dword(Slot(reg) + offset); }
+            void StoreMeta(const long reg) { Bytes({0x4C, 0x89, 0x87}); Dword(Slot(reg) + MetaOffset); }
+
+            void AddRaxReg(const long reg) { Bytes({0x48, 0x03, 0x87}); Dword(Slot(reg)); }
+            void SubRaxReg(const long reg) { Bytes({0x48, 0x2B, 0x87}); Dword(Slot(reg)); }
+
+            void AddRaxImm(const long value) {
+                if (FitsInt32(value)) { Bytes({0x48, 0x05}); Dword(static_cast<int32_t>(value)); }
+                else { MovRcxImm(value); Bytes({0x48, 0x01, 0xC8}); }
+            }
+
+            void SubRaxImm(const long value) {
+                if (FitsInt32(value)) { Bytes({0x48, 0x2D}); Dword(static_cast<int32_t>(value)); }
+                else { MovRcxImm(value); Bytes({0x48, 0x29, 0xC8}); }
+            }
+
+            void NegRax() { Bytes({0x48, 0xF7, 0xD8}); }
+            void ClearCount() { Bytes({0x45, 0x31, 0xC9}); }
+            void CmpCountBudget() { Bytes({0x49, 0x39, 0xD1}); }
+            void AddCount(const long count) { Bytes({0x49, 0x81, 0xC1}); Dword(static_cast<int32_t>(count)); }
+
+            // 累计的指令数写回调用方后返回 value
+            void Return(const long value) {
+                Bytes({0x4C, 0x01, 0x0E});
+                MovRaxImm(value);
+                Ret();
+            }
+            void TestRax() { Bytes({0x48, 0x85, 0xC0}); }
+            void Ret() { Bytes({0xC3}); }
+
+            // cmp byte [rdi + slot + tag], imm8
+            void CmpTag(const long reg, const VMAsm::RegisterTag tag) {
+                Bytes({0x80, 0xBF});
+                Dword(Slot(reg) + TagOffset);
+                Bytes({static_cast<uint8_t>(tag)});
+            }
+
+            // 发出 rel32 跳转, 返回待回填的位移位置
+            size_t Jcc(const uint8_t condition) { Bytes({0x0F, condition}); Dword(0); return Offset() - 4; }
+            size_t Jmp() { Bytes({0xE9}); Dword(0); return Offset() - 4; }
+
+            void Patch(const size_t at, const size_t target) {
+                const auto rel = static_cast<int32_t>(static_cast<long>(target) - static_cast<long>(at + 4));
+                std::memcpy(code.data() + at, &rel, sizeof(rel));
+            }
+    };
+
+    constexpr uint8_t JAE = 0x83;
+    constexpr uint8_t JE = 0x84;
+    constexpr uint8_t JNE = 0x85;
+    constexpr uint8_t JL = 0x8C;
+    constexpr uint8_t JG = 0x8F;
+
+    bool IsValueOperand(const VMAsm::OperandKind kind) {
+        return kind == VMAsm::OperandKind::Register || kind == VMAsm::OperandKind::Immediate;
+    }
+
+    // 判断单条指令能否翻译, 其余指令 (SYS、快照、字符串 MOV、寄存器间接跳转等) 留给解释器
+    bool IsTranslatable(const VMAsm::OpCode code, const VMAsm::DecodedInstruction &ins) {
+        using VMAsm::OpCode;
+        using VMAsm::OperandKind;
+        switch (code) {
+            case OpCode::NOP:
+                return true;
+            case OpCode::MOV:
+            case OpCode::NEG:
+                return IsValueOperand(ins.kinds[0]);
+            case OpCode::ADD:
+            case OpCode::SUB:
+                return IsValueOperand(ins.kinds[0]) && IsValueOperand(ins.kinds[1]);
+            case OpCode::JMP:
+                return ins.kinds[0] == OperandKind::Target;
+            case OpCode::JZ:
+            case OpCode::JNZ:
+            case OpCode::JG:
+            case OpCode::JL:
+                return IsValueOperand(ins.kinds[0]) && ins.kinds[1] == OperandKind::Target;
+            default:
+                return false;
+        }
+    }
+}
+
+VMAsm::JitFunction VMAsm::JitCompiler::Compile(const std::vector<Instruction>& instructions,
+                                               const std::vector<DecodedInstruction>& decoded, const long entry) {
+    // 确定区域: 从入口起连续的可翻译指令, 遇到无条件跳转即结束
+    const auto count = static_cast<long>(instructions.size());
+    long end = entry;
+    while (end < count && end - entry < static_cast<long>(MaxRegionLength)) {
+        const OpCode code = instructions[end].code;
+        if (!IsTranslatable(code, decoded[end])) break;
+        ++end;
+        if (code == OpCode::JMP) break;
+    }
+    if (end == entry) return nullptr;
+
+    // 区域内用到的寄存器, 入口处守卫它们都不是堆上的值, 区域内的指令也不会产生堆值
+    std::unordered_set<long> used;
+    for (long pc = entry; pc < end; ++pc) {
+        const OpCode code = instructions[pc].code;
+        const DecodedInstruction &ins = decoded[pc];
+        for (int i = 0; i < 3; ++i) {
+            if (ins.kinds[i] == OperandKind::Register) used.insert(ins.args[i]);
+        }
+        if (code == OpCode::MOV || code == OpCode::NEG) used.insert(ins.args[1]);
+        if (code == OpCode::ADD || code == OpCode::SUB) used.insert(ins.args[2]);
+    }
+
+    // 基本块起点: 入口、区域内的跳转目标以及每条跳转指令之后.
+    // 每个块在起点一次性累加自身长度, 块只会从末尾离开, 因此计数精确
+    std::vector<bool> block_start(end - entry + 1);
+    block_start[0] = true;
+    for (long pc = entry; pc < end; ++pc) {
+        const OpCode code = instructions[pc].code;
+        if (code != OpCode::JMP && code != OpCode::JZ && code != OpCode::JNZ && code != OpCode::JG && code != OpCode::JL) continue;
+        block_start[pc + 1 - entry] = true;
+        const long target = decoded[pc].args[code == OpCode::JMP ? 0 : 1];
+        if (target >= entry && target < end) block_start[target - entry] = true;
+    }
+
+    Emitter e;
+    e.ClearCount();
+    std::vector<size_t> bail_fixups;
+    for (const long reg : used) {
+        e.CmpTag(reg, RegisterTag::Heap);
+        bail_fixups.push_back(e.Jcc(JE));
+    }
+    e.MovR8Imm(InlineLongMeta);
+
+    auto load = [&](const DecodedInstruction &ins, const int index) {
+        if (ins.kinds[index] == OperandKind::Register) e.LoadRax(ins.args[index]);
+        else e.MovRaxImm(ins.args[index]);
+    };
+    auto store = [&](const long reg) {
+        e.StoreRax(reg);
+        e.StoreMeta(reg);
+    };
+
+    struct Fixup { size_t at; long source; long target; };
+    std::vector<Fixup> fixups;
+    std::vector<size_t> labels(end - entry);
+
+    long pc = entry;
+    auto jump_to = [&](const long target, const size_t at) { fixups.push_back({at, pc, target}); };
+
+    for (; pc < end; ++pc) {
+        labels[pc - entry] = e.Offset();
+        const DecodedInstruction &ins = decoded[pc];
+
+        if (block_start[pc - entry]) {
+            long next = pc + 1;
+            while (next < end && !block_start[next - entry]) ++next;
+            e.AddCount(next - pc);
+        }
+
+        switch (instructions[pc].code) {
+            case OpCode::NOP:
+                break;
+
+            case OpCode::MOV:
+                if (ins.kinds[0] == OperandKind::Register) {
+                    // 寄存器间复制整个槽, 保留源值的 size 与 tag
+                    e.LoadRax(ins.args[0]);
+                    e.LoadRcx(ins.args[0], MetaOffset);
+                    e.StoreRax(ins.args[1]);
+                    e.StoreRcx(ins.args[1], MetaOffset);
+                } else {
+                    e.MovRaxImm(ins.args[0]);
+                    store(ins.args[1]);
+                }
+                break;
+
+            case OpCode::ADD:
+                load(ins, 0);
+                if (ins.kinds[1] == OperandKind::Register) e.AddRaxReg(ins.args[1]);
+                else e.AddRaxImm(ins.args[1]);
+                store(ins.args[2]);
+                break;
+
+            case OpCode::SUB:
+                load(ins, 0);
+                if (ins.kinds[1] == OperandKind::Register) e.SubRaxReg(ins.args[1]);
+                else e.SubRaxImm(ins.args[1]);
+                store(ins.args[2]);
+                break;
+
+            case OpCode::NEG:
+                load(ins, 0);
+                e.NegRax();
+                store(ins.args[1]);
+                break;
+
+            case OpCode::JMP:
+                jump_to(ins.args[0], e.Jmp());
+                break;
+
+            case OpCode::JZ:
+            case OpCode::JNZ:
+            case OpCode::JG:
+            case OpCode::JL: {
+                const OpCode code = instructions[pc].code;
+                if (ins.kinds[0] == OperandKind::Immediate) {
+                    // 条件为常量时在编译期决定是否跳转
+                    const long value = ins.args[0];
+                    const bool taken = code == OpCode::JZ ? value == 0 :
+                                       code == OpCode::JNZ ? value != 0 :
+                                       code == OpCode::JG ? value > 0 : value < 0;
+                    if (taken) jump_to(ins.args[1], e.Jmp());
+                    break;
+                }
+                e.LoadRax(ins.args[0]);
+                e.TestRax();
+                const uint8_t condition = code == OpCode::JZ ? JE :
+                                          code == OpCode::JNZ ? JNE :
+                                          code == OpCode::JG ? JG : JL;
+                jump_to(ins.args[1], e.Jcc(condition));
+            } break;
+
+            default:
+                throw std::logic_error("Unsupported instruction in JIT region");
+        }
+    }
+
+    // 顺序执行越过区域末尾
+    if (instructions[end - 1].code != OpCode::JMP) e.Return(end);
+
+    // 每个目标只生成一个出口
+    std::vector<std::pair<long, size_t>> exits;
+    auto exit_to = [&](const long target) {
+        for (const auto &[exit_target, offset] : exits) {
+            if (exit_target == target) return offset;
+        }
+        const size_t stub = e.Offset();
+        e.Return(target);
+        exits.emplace_back(target, stub);
+        return stub;
+    };
+
+    // 回边先经过预算检查, 预算耗尽时从出口返回回边目标, 由解释器暂停
+    std::vector<std::pair<long, size_t>> back_edges;
+    auto back_edge_to = [&](const long target) {
+        for (const auto &[edge_target, offset] : back_edges) {
+            if (edge_target == target) return offset;
+        }
+        const size_t check = e.Offset();
+        e.CmpCountBudget();
+        const size_t out = e.Jcc(JAE);
+        e.Patch(e.Jmp(), labels[target - entry]);
+        e.Patch(out, exit_to(target));
+        back_edges.emplace_back(target, check);
+        return check;
+    };
+
+    // 区域内的前向跳转直接跳到目标, 区域外目标经由出口返回下标
+    for (const auto &[at, source, target] : fixups) {
+        if (target < entry || target >= end) e.Patch(at, exit_to(target));
+        else if (target <= source) e.Patch(at, back_edge_to(target));
+        else e.Patch(at, labels[target - entry]);
+    }
+
+    // 守卫失败时返回入口下标, 由解释器处理
+    const size_t bail = e.Offset();
+    e.Return(entry);
+    for (const size_t at : bail_fixups) e.Patch(at, bail);
+
+    return reinterpret_cast<JitFunction>(Install(e.code));
+}
+
+void *VMAsm::JitCompiler::Install(const std::vector<uint8_t>& code) {
+    static const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+    if (_chunks.empty() || _chunks.back().size - _chunks.back().used < code.size()) {
+        const size_t size = std::max<size_t>(64 * 1024, (code.size() + page - 1) / page * page);
+        void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED) throw std::runtime_error("JIT: unable to map code memory");
+        _chunks.push_back({static_cast<uint8_t*>(memory), size, 0});
+    }
+
+    // 代码区保持 W^X: 写入时可写不可执行, 写完后切换为可执行不可写
+    Chunk &chunk = _chunks.back();
+    if (chunk.used != 0 && mprotect(chunk.memory, chunk.size, PROT_READ | PROT_WRITE) != 0) {
+        throw std::runtime_error("JIT: unable to unprotect code memory");
+    }
+    uint8_t *target = chunk.memory + chunk.used;
+    std::memcpy(target, code.data(), code.size());
+    chunk.used = std::min(chunk.size, chunk.used + ((code.size() + 15) & ~static_cast<size_t>(15)));
+    if (mprotect(chunk.memory, chunk.size, PROT_READ | PROT_EXEC) != 0) {
+        throw std::runtime_error("JIT: unable to protect code memory");
+    }
+    return target;
+}
+
+void VMAsm::JitCompiler::Reset() {
+    for (const auto &[memory, size, used] : _chunks) munmap(memory, size);
+    _chunks.clear();
+}
+
+#else
+
+VMAsm::JitFunction VMAsm::JitCompiler::Compile(const std::vector<Instruction>&,
+                                               const std::vector<DecodedInstruction>&, long) {
+    return nullptr;
+}
+
+void *VMAsm::JitCompiler::Install(const std::vector<uint8_t>&) {
+    return nullptr;
+}
+
+void VMAsm::JitCompiler::Reset() {
+    _chunks.clear();
+}
+
+#endif
@@ -0,0 +1,606 @@
+/*******************************************************************************
+ * 文件名称: optimizer
+ * 项目名称: TEFModLoader
+ * 创建时间: 2026/10/16
+ * 作者: EternalFuture゙
+ * Github: https://github.com/eternalfuture-e38299
+ * 版权声明: Copyright © 2025 EternalFuture゙
+ * 
+ * MIT License
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+
+#include "vmasm/optimizer.hpp"
+#include "vmasm/verifier.hpp"
+#include "vmasm/vm.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+    // 跳转目标所在的操作数位置, 非跳转指令返回 -1
+    int TargetOperand(const VMAsm::OpCode code) {
+        switch (code) {
+            case VMAsm::OpCode::JMP: return 0;
+            case VMAsm::OpCode::JZ:
+            case VMAsm::OpCode::JNZ:
+            case VMAsm::OpCode::JG:
+            case VMAsm::OpCode::JL: return 1;
+            default: return -1;
+        }
+    }
+
+    // 解码时 8 字节的非寄存器操作数按整数装入; 地址引用在删除指令后会变, 不视为常量
+    std::optional<long> Immediate(const VMAsm::Value &value) {
+        if (value.is_reg || value.is_table || value.data.size() != sizeof(long)) return std::nullopt;
+        return value.to<long>();
+    }
+
+    constexpr uint64_t AllRegisters = ~uint64_t{0};
+
+    uint64_t RegisterBit(const VMAsm::Value &value) {
+        return value.is_reg ? uint64_t{1} << value.to<uint8_t>() : 0;
+    }
+
+    bool SameRegister(const VMAsm::Value &a, const VMAsm::Value &b) {
+        return a.is_reg && b.is_reg && a.to<uint8_t>() == b.to<uint8_t>();
+    }
+
+    // sub; mov; jcc => mov; sub; jcc: 让比较紧邻分支, 解码时融合为一次分派的比较跳转 (sub+jz 等超级指令).
+    // mov 不能读写 sub 的目标寄存器, 也不能写 sub 读取的寄存器
+    VMAsm::PeepholeRule MakeAdjacentBranchRule(std::string name, const VMAsm::OpCode branch) {
+        using VMAsm::Instruction;
+        return {std::move(name), {VMAsm::OpCode::SUB, VMAsm::OpCode::MOV, branch},
+                [](const std::vector<Instruction> &window, std::vector<Instruction> &replacement) {
+                    const auto &sub = window[0].Args;
+                    const auto &mov = window[1].Args;
+                    if (!SameRegister(window[2].Args[0], sub[2])) return false;
+                    if (SameRegister(mov[0], sub[2]) || SameRegister(mov[1], sub[2]) ||
+                        SameRegister(sub[0], mov[1]) || SameRegister(sub[1], mov[1])) {
+                        return false;
+                    }
+                    replacement = {window[1], window[0], window[2]};
+                    return true;
+                }};
+    }
+
+    bool SameInstruction(const VMAsm::Instruction &a, const VMAsm::Instruction &b) {
+        if (a.code != b.code || a.Args.size() != b.Args.size()) return false;
+        for (size_t i = 0; i < a.Args.size(); ++i) {
+            const auto &x = a.Args[i];
+            const auto &y = b.Args[i];
+            if (x.is_reg != y.is_reg || x.is_table != y.is_table || x.data != y.data) return false;
+        }
+        return true;
+    }
+
+    VMAsm::Value MakeImmediate(const long number) {
+        VMAsm::Value value;
+        value.write(number);
+        return value;
+    }
+
+}
+
+void VMAsm::Optimizer::Run(std::vector<Instruction> &instructions, std::unordered_map<std::string, long> &tables,
+                           const std::unordered_set<std::string> &entries) {
+    if (_level <= OptimizeNone || HasIndirectJumps(instructions)) return;
+
+    _removed.assign(instructions.size(), false);
+    FoldConstants(instructions, FindLeaders(instructions, tables));
+    ApplyPeephole(instructions, tables);
+    if (_level >= OptimizeDeadCode) {
+        // 先串联再取反: 串联后条件跳转已指向终点, 取反只处理仍然越过一条 jmp 的分支
+        ThreadJumps(instructions);
+        InvertBranches(instructions, FindLeaders(instructions, tables));
+        RemoveUnreachable(instructions, tables, entries);
+        // 删除一条死存储可能让为它提供操作数的写入也变成死存储
+        while (RemoveDeadStores(instructions)) {}
+        RemoveFallthroughJumps(instructions);
+    }
+    Compact(instructions, tables);
+}
+
+const std::vector<VMAsm::PeepholeRule> &VMAsm::Optimizer::GetBuiltinRules() {
+    // add R, 0, R 之类的恒等运算会把非整数的寄存器改写为整数, 只看窗口无法判断,
+    // 因此由 FoldConstants 在已知寄存器为整数时处理
+    static const std::vector<PeepholeRule> rules = {
+        {"mov-self", {OpCode::MOV}, [](const std::vector<Instruction> &window, std::vector<Instruction> &) {
+            return SameRegister(window[0].Args[0], window[0].Args[1]);
+        }},
+        // sub R, R, D 的结果恒为零, 其后测试 D 的条件跳转方向已知
+        {"sub-self-jz", {OpCode::SUB, OpCode::JZ},
+         [](const std::vector<Instruction> &window, std::vector<Instruction> &replacement) {
+             const auto &sub = window[0].Args;
+             const auto &jump = window[1].Args;
+             if (!SameRegister(sub[0], sub[1]) || !SameRegister(jump[0], sub[2])) return false;
+             replacement = {{OpCode::MOV, {MakeImmediate(0), sub[2]}}, {OpCode::JMP, {jump[1]}}};
+             return true;
+         }},
+        {"sub-self-jnz", {OpCode::SUB, OpCode::JNZ},
+         [](const std::vector<Instruction> &window, std::vector<Instruction> &replacement) {
+             const auto &sub = window[0].Args;
+             if (!SameRegister(sub[0], sub[1]) || !SameRegister(window[1].Args[0], sub[2])) return false;
+             replacement = {{OpCode::MOV, {MakeImmediate(0), sub[2]}}};
+             return true;
+         }},
+        MakeAdjacentBranchRule("sub-jz-adjacent", OpCode::JZ),
+        MakeAdjacentBranchRule("sub-jnz-adjacent", OpCode::JNZ),
+        MakeAdjacentBranchRule("sub-jg-adjacent", OpCode::JG),
+    };
+    return rules;
+}
+
+void VMAsm::Optimizer::ApplyPeephole(std::vector<Instruction> &instructions,
+                                     const std::unordered_map<std::string, long> &tables) {
+    std::vector<const PeepholeRule *> rules;
+    for (const auto &rule : GetBuiltinRules()) rules.push_back(&rule);
+    for (const auto &rule : _rules) rules.push_back(&rule);
+
+    _stats.peephole.clear();
+    for (const auto *rule : rules) _stats.peephole.push_back({rule->name, 0});
+
+    // 一条规则的结果可能构成另一条规则的窗口, 反复扫描直到没有规则命中.
+    // 互相改回对方结果的规则永远不会停下, 命中总数超过上限时报错
+    const size_t limit = 4 * instructions.size() + 16;
+    size_t applied = 0;
+    for (bool changed = true; changed;) {
+        changed = false;
+        const auto leaders = FindLeaders(instructions, tables);
+        for (size_t pc = 0; pc < instructions.size(); ++pc) {
+            if (_removed[pc]) continue;
+            for (size_t r = 0; r < rules.size(); ++r) {
+                if (!ApplyRule(instructions, leaders, *rules[r], pc)) continue;
+                if (++applied > limit) {
+                    throw std::runtime_error("Peephole rule " + rules[r]->name + " keeps rewriting, the rules do not converge");
+                }
+                ++_stats.peephole[r].hits;
+                changed = true;
+                break;
+            }
+        }
+    }
+}
+
+bool VMAsm::Optimizer::ApplyRule(std::vector<Instruction> &instructions, const std::vector<bool> &leaders,
+                                 const PeepholeRule &rule, const size_t pc) {
+    const auto &sequence = rule.sequence;
+    if (sequence.empty()) return false;
+
+    // 窗口由连续的未删除指令组成; 除第一条外都不能被跳入
+    std::vector<size_t> slots{pc};
+    while (slots.size() < sequence.size()) {
+        const size_t next = NextKept(slots.back() + 1);
+        if (next >= instructions.size()) return false;
+        for (size_t i = slots.back() + 1; i <= next; ++i) {
+            if (leaders[i]) return false;
+        }
+        slots.push_back(next);
+    }
+    for (size_t i = 0; i < slots.size(); ++i) {
+        if (instructions[slots[i]].code != sequence[i]) return false;
+    }
+
+    std::vector<Instruction> window;
+    window.reserve(slots.size());
+    for (const size_t slot : slots) window.push_back(instructions[slot]);
+
+    std::vector<Instruction> replacement;
+    if (!rule.rewrite(window, replacement)) return false;
+    if (replacement.size() > slots.size()) {
+        throw std::runtime_error("Peephole rule " + rule.name + " produced more instructions than it matched");
+    }
+    // 原样返回窗口不算命中, 否则会反复匹配同一位置
+    if (replacement.size() == window.size() &&
+        std::equal(replacement.begin(), replacement.end(), window.begin(), SameInstruction)) {
+        return false;
+    }
+    // 后续规则与优化假定指令合法, 自定义规则的输出在写回前校验
+    for (size_t i = 0; i < replacement.size(); ++i) {
+        try {
+            Verifier::VerifyInstruction(replacement[i], slots[i], instructions.size());
+        } catch (const std::exception &e) {
+            throw std::runtime_error("Peephole rule " + rule.name + ": " + e.what());
+        }
+    }
+
+    for (size_t i = 0; i < slots.size(); ++i) {
+        if (i < replacement.size()) instructions[slots[i]] = std::move(replacement[i]);
+        else _removed[slots[i]] = true;
+    }
+    return true;
+}
+
+bool VMAsm::Optimizer::HasIndirectJumps(const std::vector<Instruction> &instructions) {
+    for (const auto &[code, Args] : instructions) {
+        if (const int target = TargetOperand(code); target >= 0 && Args[target].is_reg) return true;
+    }
+    return false;
+}
+
+std::vector<bool> VMAsm::Optimizer::FindLeaders(const std::vector<Instruction> &instructions,
+                                                const std::unordered_map<std::string, long> &tables) {
+    // 基本块的起点: 程序入口、表 (执行入口与标签) 指向的位置和静态跳转目标
+    std::vector<bool> leaders(instructions.size() + 1, false);
+    leaders[0] = true;
+    for (const auto &[name, address] : tables) leaders[address] = true;
+
+    for (const auto &[code, Args] : instructions) {
+        if (const int target = TargetOperand(code); target >= 0) leaders[Args[target].to<long>()] = true;
+    }
+    return leaders;
+}
+
+std::optional<long> VMAsm::Optimizer::Propagate(Value &value, const Constants &known) {
+    if (!value.is_reg) return Immediate(value);
+
+    const auto constant = known[value.to<uint8_t>()];
+    if (constant) {
+        value = MakeImmediate(*constant);
+        ++_stats.propagated;
+    }
+    return constant;
+}
+
+void VMAsm::Optimizer::FoldConstants(std::vector<Instruction> &instructions, const std::vector<bool> &leaders) {
+    Constants known{};
+    // 值未知但一定是整数的寄存器: 算术指令的结果, 或从这样的寄存器复制而来
+    Registers integers = 0;
+
+    for (size_t pc = 0; pc < instructions.size(); ++pc) {
+        // 其他路径可能跳入, 块起点处什么都不知道
+        if (leaders[pc]) {
+            known.fill(std::nullopt);
+            integers = 0;
+        }
+
+        auto &[code, Args] = instructions[pc];
+        switch (code) {
+            case OpCode::MOV: {
+                const auto value = Propagate(Args[0], known);
+                const Registers bit = RegisterBit(Args[1]);
+                if (value || (RegisterBit(Args[0]) & integers)) integers |= bit;
+                else integers &= ~bit;
+                known[Args[1].to<uint8_t>()] = value;
+                break;
+            }
+
+            case OpCode::ADD:
+            case OpCode::SUB:
+            case OpCode::NEG: {
+                const bool unary = code == OpCode::NEG;
+                const auto lhs = Propagate(Args[0], known);
+                const auto rhs = unary ? std::optional<long>(0) : Propagate(Args[1], known);
+                Value dst = Args[unary ? 1 : 2];
+
+                std::optional<long> result;
+                if (lhs && rhs) {
+                    // 按无符号回绕计算, 与运行时的结果一致且不触发有符号溢出
+                    const auto a = static_cast<unsigned long>(*lhs);
+                    const auto b = static_cast<unsigned long>(*rhs);
+                    result = static_cast<long>(code == OpCode::ADD ? a + b : code == OpCode::SUB ? a - b : 0 - a);
+
+                    code = OpCode::MOV;
+                    Args = {MakeImmediate(*result), dst};
+                    ++_stats.folded;
+                } else if (!unary) {
+                    // x + 0, 0 + x, x - 0: 运行时按整数读取 x, 只有 x 已经是整数时结果才与 x 相同
+                    const Value *same = nullptr;
+                    if (rhs == 0) same = &Args[0];
+                    else if (lhs == 0 && code == OpCode::ADD) same = &Args[1];
+
+                    if (same && (RegisterBit(*same) & integers)) {
+                        if (SameRegister(*same, dst)) {
+                            _removed[pc] = true;
+                        } else {
+                            const Value source = *same;
+                            code = OpCode::MOV;
+                            Args = {source, dst};
+                        }
+                        ++_stats.folded;
+                    }
+                }
+                known[dst.to<uint8_t>()] = result;
+                integers |= RegisterBit(dst);
+                break;
+            }
+
+            case OpCode::JZ:
+            case OpCode::JNZ:
+            case OpCode::JG:
+            case OpCode::JL: {
+                const auto condition = Propagate(Args[0], known);
+                if (!condition) break;
+
+                const bool taken = code == OpCode::JZ ? *condition == 0 :
+                                   code == OpCode::JNZ ? *condition != 0 :
+                                   code == OpCode::JG ? *condition > 0 : *condition < 0;
+                if (taken) {
+                    code = OpCode::JMP;
+                    Args = {Args[1]};
+                } else {
+                    _removed[pc] = true;
+                }
+                ++_stats.branches;
+                break;
+            }
+
+            // 快照指令与系统调用会改写寄存器
+            case OpCode::SNAP_SWAP:
+            case OpCode::SNAP_POP:
+            case OpCode::REGS_CLEAR:
+            case OpCode::SYS:
+                known.fill(std::nullopt);
+                integers = 0;
+                break;
+
+            default:
+                break;
+        }
+    }
+}
+
+size_t VMAsm::Optimizer::NextKept(size_t pc) const {
+    while (pc < _removed.size() && _removed[pc]) ++pc;
+    return pc;
+}
+
+size_t VMAsm::Optimizer::Resolve(const std::vector<Instruction> &instructions, const size_t target) const {
+    size_t current = NextKept(target);
+    for (size_t hops = 0; current < instructions.size(); ++hops) {
+        const auto &[code, Args] = instructions[current];
+        if (code != OpCode::JMP || Args[0].is_reg) return current;
+        if (hops == instructions.size()) return target;
+        current = NextKept(Args[0].to<long>());
+    }
+    return current;
+}
+
+void VMAsm::Optimizer::ThreadJumps(std::vector<Instruction> &instructions) {
+    // 表仍指向原来的位置, 从表进入的执行路径不变
+    for (size_t pc = 0; pc < instructions.size(); ++pc) {
+        if (_removed[pc]) continue;
+
+        auto &[code, Args] = instructions[pc];
+        const int target = TargetOperand(code);
+        if (target < 0 || Args[target].is_reg) continue;
+
+        const auto original = Args[target].to<long>();
+        if (const auto final = static_cast<long>(Resolve(instructions, original)); final != original) {
+            Args[target].write(final);
+            ++_stats.threaded;
+        }
+    }
+}
+
+void VMAsm::Optimizer::InvertBranches(std::vector<Instruction> &instructions, const std::vector<bool> &leaders) {
+    // jz R, #a; jmp #b; a: ...  =>  jnz R, #b; a: ...
+    // 只有 jz 与 jnz 互为反条件; 被越过的 jmp 不能是其他跳转的目标或表入口
+    for (size_t pc = 0; pc < instructions.size(); ++pc) {
+        auto &[code, Args] = instructions[pc];
+        if (_removed[pc] || (code != OpCode::JZ && code != OpCode::JNZ)) continue;
+
+        const size_t jump = NextKept(pc + 1);
+        if (jump >= instructions.size()) continue;
+
+        const auto &[next_code, next_args] = instructions[jump];
+        if (next_code != OpCode::JMP || next_args[0].is_reg) continue;
+        if (NextKept(Args[1].to<long>()) != NextKept(jump + 1)) continue;
+
+        bool entered = false;
+        for (size_t i = pc + 1; i <= jump && !entered; ++i) entered = leaders[i];
+        if (entered) continue;
+
+        code = code == OpCode::JZ ? OpCode::JNZ : OpCode::JZ;
+        Args[1] = next_args[0];
+        _removed[jump] = true;
+        ++_stats.inverted;
+    }
+}
+
+void VMAsm::Optimizer::RemoveFallthroughJumps(const std::vector<Instruction> &instructions) {
+    // 条件跳转的条件没有副作用, 目标与顺序执行相同时同样可以删除.
+    // 从后向前处理, 删除一条跳转后前面跳过它的跳转也会变成顺序执行
+    for (size_t pc = instructions.size(); pc-- > 0;) {
+        const auto &[code, Args] = instructions[pc];
+        const int target = TargetOperand(code);
+        if (_removed[pc] || target < 0 || Args[target].is_reg) continue;
+        if (NextKept(Args[target].to<long>()) != NextKept(pc + 1)) continue;
+
+        _removed[pc] = true;
+        ++_stats.fallthrough;
+    }
+}
+
+size_t VMAsm::Optimizer::Successors(const std::vector<Instruction> &instructions, const size_t pc,
+                                    size_t next[2]) const {
+    // 已删除的指令 (不会跳转的条件跳转) 只是顺序执行到下一条
+    if (_removed[pc]) {
+        next[0] = pc + 1;
+        return 1;
+    }
+
+    const auto &[code, Args] = instructions[pc];
+    switch (code) {
+        case OpCode::HALT:
+            next[0] = instructions.size();
+            return 1;
+        case OpCode::JMP:
+            next[0] = Args[0].to<long>();
+            return 1;
+        case OpCode::JZ:
+        case OpCode::JNZ:
+        case OpCode::JG:
+        case OpCode::JL:
+            next[0] = pc + 1;
+            next[1] = Args[1].to<long>();
+            return 2;
+        default:
+            next[0] = pc + 1;
+            return 1;
+    }
+}
+
+void VMAsm::Optimizer::Access(const Instruction &instruction, Registers &use, Registers &def) {
+    const auto &[code, Args] = instruction;
+    use = def = 0;
+
+    switch (code) {
+        case OpCode::MOV:
+        case OpCode::NEG:
+            use = RegisterBit(Args[0]);
+            def = RegisterBit(Args[1]);
+            break;
+        case OpCode::ADD:
+        case OpCode::SUB:
+            use = RegisterBit(Args[0]) | RegisterBit(Args[1]);
+            def = RegisterBit(Args[2]);
+            break;
+        case OpCode::JZ:
+        case OpCode::JNZ:
+        case OpCode::JG:
+        case OpCode::JL:
+            use = RegisterBit(Args[0]);
+            break;
+        // 处理函数可以读取任意寄存器; 写入的寄存器未知, 不视为覆盖
+        case OpCode::SYS:
+        // 整组寄存器被保存到快照中, 之后可能被换回
+        case OpCode::SNAP_SAVE:
+        case OpCode::SNAP_PUSH:
+            use = AllRegisters;
+            break;
+        case OpCode::SNAP_SWAP:
+        case OpCode::SNAP_POP:
+            use = def = AllRegisters;
+            break;
+        case OpCode::REGS_CLEAR:
+            def = AllRegisters;
+            break;
+        default:
+            break;
+    }
+}
+
+void VMAsm::Optimizer::RemoveUnreachable(const std::vector<Instruction> &instructions,
+                                         const std::unordered_map<std::string, long> &tables,
+                                         const std::unordered_set<std::string> &entries) {
+    // 入口是程序开头、main 与声明的表; 只能经由标签到达的代码块从入口不可达时同样删除
+    const size_t size = instructions.size();
+    std::vector<bool> reached(size + 1, false);
+    std::vector<size_t> pending{0};
+    if (const auto main = tables.find("main"); main != tables.end()) pending.push_back(main->second);
+    for (const auto &name : entries) {
+        if (const auto it = tables.find(name); it != tables.end()) pending.push_back(it->second);
+    }
+
+    while (!pending.empty()) {
+        const size_t pc = pending.back();
+        pending.pop_back();
+        if (pc >= size || reached[pc]) continue;
+        reached[pc] = true;
+
+        size_t next[2];
+        for (size_t i = 0, count = Successors(instructions, pc, next); i < count; ++i) pending.push_back(next[i]);
+    }
+
+    for (size_t pc = 0; pc < size; ++pc) {
+        if (reached[pc] || _removed[pc]) continue;
+        _removed[pc] = true;
+        ++_stats.unreachable;
+    }
+}
+
+bool VMAsm::Optimizer::RemoveDeadStores(const std::vector<Instruction> &instructions) {
+    // 反向数据流求每条指令出口处的活跃寄存器. 执行结束后宿主可以读取寄存器, 因此出口处全部活跃
+    const size_t size = instructions.size();
+    std::vector<Registers> live_in(size + 1, 0);
+    live_in[size] = AllRegisters;
+
+    std::vector<Registers> use(size), def(size);
+    for (size_t pc = 0; pc < size; ++pc) {
+        if (!_removed[pc]) Access(instructions[pc], use[pc], def[pc]);
+    }
+
+    std::vector<Registers> live_out(size, 0);
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (size_t pc = size; pc-- > 0;) {
+            size_t next[2];
+            Registers out = 0;
+            for (size_t i = 0, count = Successors(instructions, pc, next); i < count; ++i) out |= live_in[next[i]];
+
+            const Registers in = use[pc] | (out & ~def[pc]);
+            live_out[pc] = out;
+            if (in != live_in[pc]) {
+                live_in[pc] = in;
+                changed = true;
+            }
+        }
+    }
+
+    bool removed = false;
+    for (size_t pc = 0; pc < size; ++pc) {
+        if (_removed[pc]) continue;
+
+        const OpCode code = instructions[pc].code;
+        if (code != OpCode::MOV && code != OpCode::ADD && code != OpCode::SUB && code != OpCode::NEG) continue;
+        if (def[pc] & live_out[pc]) continue;
+
+        _removed[pc] = true;
+        ++_stats.dead_stores;
+        removed = true;
+    }
+    return removed;
+}
+
+void VMAsm::Optimizer::Compact(std::vector<Instruction> &instructions, std::unordered_map<std::string, long> &tables) {
+    // 被删除的位置映射到其后第一条保留的指令, 末尾映射到新的末尾
+    std::vector<long> remap(instructions.size() + 1);
+    long next = 0;
+    for (size_t pc = 0; pc < instructions.size(); ++pc) {
+        remap[pc] = next;
+        if (!_removed[pc]) ++next;
+    }
+    remap[instructions.size()] = next;
+    if (static_cast<size_t>(next) == instructions.size()) return;
+
+    const size_t pc_end = instructions.size();
+    std::vector<Instruction> kept;
+    kept.reserve(next);
+    for (size_t pc = 0; pc < instructions.size(); ++pc) {
+        if (_removed[pc]) continue;
+
+        auto &[code, Args] = instructions[pc];
+        const int target = TargetOperand(code);
+        for (size_t i = 0; i < Args.size(); ++i) {
+            if (Args[i].is_reg || (!Args[i].is_table && static_cast<int>(i) != target)) continue;
+            if (const long address = Args[i].to<long>(); address >= 0 && address <= static_cast<long>(pc_end)) {
+                Args[i].write(remap[address]);
+            }
+        }
+        kept.push_back(std::move(instructions[pc]));
+    }
+
+    for (auto &[name, address] : tables) address = remap[address];
+
+    _stats.removed += instructions.size() - kept.size();
+    instructions = std::move(kept);
+}
@@ -0,0 +1,230 @@
+/*******************************************************************************
+ * 文件名称: profiler
+ * 项目名称: TEFModLoader
+ * 创建时间: 2026/10/16
+ * 作者: EternalFuture゙
+ * Github: https://github.com/eternalfuture-e38299
+ * 版权声明: Copyright © 2025 EternalFuture゙
+ * 
+ * MIT License
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+
+#include "vmasm/profiler.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <utility>
+
+namespace {
+    const char *OpCodeName(const VMAsm::OpCode code) {
+        switch (code) {
+            case VMAsm::OpCode::NOP: return "nop";
+            case VMAsm::OpCode::JMP: return "jmp";
+            case VMAsm::OpCode::MOV: return "mov";
+            case VMAsm::OpCode::ADD: return "add";
+            case VMAsm::OpCode::SUB: return "sub";
+            case VMAsm::OpCode::NEG: return "neg";
+            case VMAsm::OpCode::SNAP_SAVE: return "snap_save";
+            case VMAsm::OpCode::SNAP_SWAP: return "snap_swap";
+            case VMAsm::OpCode::SNAP_CLEAR: return "snap_clear";
+            case VMAsm::OpCode::REGS_CLEAR: return "regs_clear";
+            case VMAsm::OpCode::JZ: return "jz";
+            case VMAsm::OpCode::JNZ: return "jnz";
+            case VMAsm::OpCode::JG: return "jg";
+            case VMAsm::OpCode::JL: return "jl";
+            case VMAsm::OpCode::HALT: return "halt";
+            case VMAsm::OpCode::SYS: return "sys";
+            case VMAsm::OpCode::SNAP_PUSH: return "snap_push";
+            case VMAsm::OpCode::SNAP_POP: return "snap_pop";
+            default: return "?";
+        }
+    }
+
+    // 标签按下标排序, 同一位置有多个标签时取名字最小的一个
+    class LabelMap {
+        std::vector<std::pair<long, std::string>> _labels{};
+
+        public:
+            explicit LabelMap(const std::unordered_map<std::string, long> &tables) {
+                for (const auto &[name, index] : tables) _labels.emplace_back(index, name);
+                std::sort(_labels.begin(), _labels.end());
+                _labels.erase(std::unique(_labels.begin(), _labels.end(),
+                                          [](const auto &a, const auto &b) { return a.first == b.first; }),
+                              _labels.end());
+            }
+
+            // 返回所属标签在 _labels 中的下标, 位于第一个标签之前时返回 -1
+            long Find(const long pc) const {
+                const auto it = std::upper_bound(_labels.begin(), _labels.end(), pc,
+                                                 [](const long value, const auto &label) { return value < label.first; });
+                return static_cast<long>(it - _labels.begin()) - 1;
+            }
+
+            std::string Name(const long label) const { return label < 0 ? "<start>" : _labels[label].second; }
+
+            std::string Locate(const long pc) const {
+                const long label = Find(pc);
+                const long offset = pc - (label < 0 ? 0 : _labels[label].first);
+                return offset == 0 ? Name(label) : Name(label) + "+" + std::to_string(offset);
+            }
+    };
+
+    std::string Percent(const uint64_t count, const uint64_t total) {
+        std::ostringstream ss;
+        ss << std::fixed << std::setprecision(1) << (total ? 100.0 * static_cast<double>(count) / static_cast<double>(total) : 0.0) << "%";
+        return ss.str();
+    }
+}
+
+void VMAsm::Profile::Reset(const size_t size) {
+    instructions.assign(size, 0);
+    opcodes.fill(0);
+    syscalls.fill(SyscallProfile{});
+}
+
+uint64_t VMAsm::Profile::GetTotal() const {
+    uint64_t total = 0;
+    for (const uint64_t count : instructions) total += count;
+    return total;
+}
+
+std::string VMAsm::Profile::Report(const Program &program, const size_t limit) const {
+    const uint64_t total = GetTotal();
+    const LabelMap labels(program.GetTables());
+    std::ostringstream ss;
+
+    ss << "Profile: " << total << " instruction(s)\n";
+
+    // 按标签汇总
+    std::map<long, uint64_t> by_label;
+    for (size_t pc = 0; pc < instructions.size(); ++pc) {
+        if (instructions[pc] != 0) by_label[labels.Find(static_cast<long>(pc))] += instructions[pc];
+    }
+    std::vector<std::pair<uint64_t, long>> label_rows;
+    for (const auto &[label, count] : by_label) label_rows.emplace_back(count, label);
+    std::sort(label_rows.begin(), label_rows.end(), [](const auto &a, const auto &b) { return a.first > b.first; });
+
+    ss << "\nLabels:\n" << std::setw(14) << "count" << std::setw(9) << "share" << "  label\n";
+    for (size_t i = 0; i < label_rows.size() && i < limit; ++i) {
+        ss << std::setw(14) << label_rows[i].first << std::setw(9) << Percent(label_rows[i].first, total)
+           << "  " << labels.Name(label_rows[i].second) << "\n";
+    }
+
+    // 热点指令
+    std::vector<size_t> hot;
+    for (size_t pc = 0; pc < instructions.size(); ++pc) {
+        if (instructions[pc] != 0) hot.push_back(pc);
+    }
+    std::stable_sort(hot.begin(), hot.end(), [this](const size_t a, const size_t b) { return instructions[a] > instructions[b]; });
+
+    ss << "\nHot spots:\n" << std::setw(14) << "count" << std::setw(9) << "share" << std::setw(8) << "pc" << "  location\n";
+    for (size_t i = 0; i < hot.size() && i < limit; ++i) {
+        const size_t pc = hot[i];
+        ss << std::setw(14) << instructions[pc] << std::setw(9) << Percent(instructions[pc], total)
+           << std::setw(8) << pc << "  " << labels.Locate(static_cast<long>(pc))
+           << " (" << OpCodeName(program.GetInstructions()[pc].code) << ")\n";
+    }
+
+    // 指令类型
+    std::vector<size_t> codes;
+    for (size_t code = 0; code < OpCodeCount; ++code) {
+        if (opcodes[code] != 0) codes.push_back(code);
+    }
+    std::stable_sort(codes.begin(), codes.end(), [this](const size_t a, const size_t b) { return opcodes[a] > opcodes[b]; });
+
+    ss << "\nOpcodes:\n" << std::setw(14) << "count" << std::setw(9) << "share" << "  opcode\n";
+    for (const size_t code : codes) {
+        ss << std::setw(14) << opcodes[code] << std::setw(9) << Percent(opcodes[code], total)
+           << "  " << OpCodeName(static_cast<OpCode>(code)) << "\n";
+    }
+
+    // 系统调用耗时
+    bool header = false;
+    for (size_t id = 0; id < SyscallCount; ++id) {
+        const SyscallProfile &syscall = syscalls[id];
+        if (syscall.calls == 0) continue;
+        if (!header) {
+            ss << "\nSyscalls:\n" << std::setw(14) << "calls" << std::setw(14) << "total ms" << std::setw(12) << "avg ns" << "  id\n";
+            header = true;
+        }
+        ss << std::setw(14) << syscall.calls << std::setw(14) << std::fixed << std::setprecision(3)
+           << static_cast<double>(syscall.nanoseconds) / 1e6 << std::setw(12) << std::setprecision(0)
+           << static_cast<double>(syscall.nanoseconds) / static_cast<double>(syscall.calls) << "  " << id << "\n";
+    }
+
+    return ss.str();
+}
+
+VMAsm::SamplingProfiler::SamplingProfiler(const uint64_t interval) : _interval(std::max<uint64_t>(interval, 1)) {}
+
+int VMAsm::SamplingProfiler::Execute(VirtualMachine &vm, const std::string &table) {
+    const auto &program = vm.GetProgram();
+    if (program != _program) {
+        // 换了程序, 旧样本的下标不再有意义
+        _program = program;
+        _samples.assign(program->Size(), 0);
+    }
+    _entry = table;
+    return Continue(vm, vm.Execute(table, _interval));
+}
+
+int VMAsm::SamplingProfiler::Resume(VirtualMachine &vm) {
+    return Continue(vm, vm.Resume(_interval));
+}
+
+int VMAsm::SamplingProfiler::Continue(VirtualMachine &vm, int status) {
+    while (status == StatusYielded) {
+        const long pc = vm.GetProgramCounter();
+        if (pc >= 0 && static_cast<size_t>(pc) < _samples.size()) _samples[pc]++;
+        status = vm.Resume(_interval);
+    }
+    return status;
+}
+
+uint64_t VMAsm::SamplingProfiler::GetSampleCount() const {
+    uint64_t total = 0;
+    for (const uint64_t count : _samples) total += count;
+    return total;
+}
+
+void VMAsm::SamplingProfiler::Reset() {
+    std::fill(_samples.begin(), _samples.end(), 0);
+}
+
+std::string VMAsm::SamplingProfiler::Collapse() const {
+    if (!_program) return {};
+
+    const LabelMap labels(_program->GetTables());
+    std::map<std::string, uint64_t> stacks;
+    for (size_t pc = 0; pc < _samples.size(); ++pc) {
+        if (_samples[pc] == 0) continue;
+
+        // 没有调用栈, 以入口为根, 所在标签为叶; 落在入口标签本身时只有一层
+        const std::string label = labels.Name(labels.Find(static_cast<long>(pc)));
+        stacks[label == _entry ? _entry : _entry + ";" + label] += _samples[pc];
+    }
+
+    std::ostringstream ss;
+    for (const auto &[stack, count] : stacks) ss << stack << " " << count << "\n";
+    return ss.str();
+}
@@ -0,0 +1,259 @@
+/*******************************************************************************
+ * 文件名称: program
+ * 项目名称: TEFModLoader
+ * 创建时间: 2026/10/16
+ * 作者: EternalFuture゙
+ * Github: https://github.com/eternalfuture-e38299
+ * 版权声明: Copyright © 2025 EternalFuture゙
+ * 
+ * MIT License
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+
+#include "vmasm/vm.hpp"
+
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+
+VMAsm::Program::Program(std::vector<Instruction> instructions, std::unordered_map<std::string, long> tables,
+                        const bool fusion) :
+    _instructions(std::move(instructions)), _tables(std::move(tables)), _fusion_enabled(fusion) {
+    Decode();
+}
+
+std::shared_ptr<const VMAsm::Program> VMAsm::Program::Create(std::vector<Instruction> instructions,
+                                                             std::unordered_map<std::string, long> tables,
+                                                             const bool fusion) {
+    return std::shared_ptr<const Program>(new Program(std::move(instructions), std::move(tables), fusion));
+}
+
+const std::shared_ptr<const VMAsm::Program>& VMAsm::Program::Empty() {
+    static const std::shared_ptr<const Program> empty = Create({}, {});
+    return empty;
+}
+
+long VMAsm::Program::FindTable(const std::string &name) const {
+    const auto it = _tables.find(name);
+    return it != _tables.end() ? it->second : -1;
+}
+
+long VMAsm::Program::DecodeFormat(const std::vector<Value> &args) {
+    // 调用编号在执行时才绑定到处理函数, 这里只能把常量字符串都当作可能的格式串解析.
+    // 解析失败的留给处理函数在执行到时报错
+    if (args.size() < 2 || args[1].is_reg || args[1].is_table || args[1].data.empty()) return -1;
+
+    // 字符串常量以唯一的 '\0' 结尾, 数值常量 (固定 8 字节) 通常含多个零字节
+    const auto &data = args[1].data;
+    if (std::memchr(data.data(), '\0', data.size()) != &data.back()) return -1;
+
+    try {
+        _formats.push_back(Format::Parse(args[1].to<std::string>()));
+    } catch (const std::exception &) {
+        return -1;
+    }
+    return static_cast<long>(_formats.size() - 1);
+}
+
+uint8_t VMAsm::Program::DecodeRegister(const Value &value) {
+    const auto reg = value.to<uint8_t>();
+    if (reg >= 64) throw std::runtime_error("Register index out of range: " + std::to_string(reg));
+    return reg;
+}
+
+void VMAsm::Program::DecodeOperand(DecodedInstruction &decoded, const int index, const Value &value,
+                                          const OperandKind expected) {
+    if (value.is_reg) {
+        decoded.kinds[index] = OperandKind::Register;
+        decoded.args[index] = DecodeRegister(value);
+        return;
+    }
+
+    if (expected == OperandKind::Target) {
+        decoded.kinds[index] = OperandKind::Target;
+        decoded.args[index] = ClampTarget(value.to<long>());
+        return;
+    }
+
+    if (expected != OperandKind::Constant || value.data.size() == sizeof(long)) {
+        decoded.kinds[index] = OperandKind::Immediate;
+        decoded.args[index] = value.to<long>();
+        return;
+    }
+
+    decoded.kinds[index] = OperandKind::Constant;
+    decoded.args[index] = static_cast<long>(_constants.size());
+    _constants.push_back(value);
+}
+
+long VMAsm::Program::ClampTarget(const long target) const {
+    // 越界的静态跳转目标在解码时指向末尾哨兵, 执行时无需再做边界检查
+    const auto end = static_cast<long>(_instructions.size());
+    return static_cast<unsigned long>(target) < static_cast<unsigned long>(end) ? target : end;
+}
+
+void VMAsm::Program::Decode() {
+    _decoded.reserve(_instructions.size() + 1);
+
+    for (size_t pc = 0; pc < _instructions.size(); ++pc) {
+        const auto &[code, Args] = _instructions[pc];
+        DecodedInstruction decoded;
+        decoded.code = code;
+
+        auto require = [&](const size_t count) {
+            if (Args.size() < count) {
+                throw std::runtime_error("Instruction " + std::to_string(pc) + " requires " +
+                                         std::to_string(count) + " operands");
+            }
+        };
+
+        switch (code) {
+            case OpCode::JMP:
+                require(1);
+                DecodeOperand(decoded, 0, Args[0], OperandKind::Target);
+                break;
+
+            case OpCode::MOV:
+                require(2);
+                DecodeOperand(decoded, 0, Args[0], OperandKind::Constant);
+                decoded.kinds[1] = OperandKind::Register;
+                decoded.args[1] = DecodeRegister(Args[1]);
+                break;
+
+            case OpCode::ADD:
+            case OpCode::SUB:
+                require(3);
+                DecodeOperand(decoded, 0, Args[0], OperandKind::Immediate);
+                DecodeOperand(decoded, 1, Args[1], OperandKind::Immediate);
+                decoded.kinds[2] = OperandKind::Register;
+                decoded.args[2] = DecodeRegister(Args[2]);
+                break;
+
+            case OpCode::NEG:
+                require(2);
+                DecodeOperand(decoded, 0, Args[0], OperandKind::Immediate);
+                decoded.kinds[1] = OperandKind::Register;
+                decoded.args[1] = DecodeRegister(Args[1]);
+                break;
+
+            case OpCode::JZ:
+            case OpCode::JNZ:
+            case OpCode::JG:
+            case OpCode::JL:
+                require(2);
+                DecodeOperand(decoded, 0, Args[0], OperandKind::Immediate);
+                DecodeOperand(decoded, 1, Args[1], OperandKind::Target);
+                break;
+
+            case OpCode::SYS:
+                // 参数数量不定: 调用编号与调用点编号存入解码映像, 参数预解码到单独的数组中
+                if (Args.empty()) throw std::runtime_error("SYS call requires at least call ID");
+                decoded.kinds[0] = OperandKind::Immediate;
+                decoded.args[0] = Args[0].to<uint8_t>();
+                decoded.kinds[1] = OperandKind::Immediate;
+                decoded.args[1] = static_cast<long>(_syscall_sites.size());
+
+                _syscall_sites.push_back({static_cast<long>(pc), static_cast<uint8_t>(decoded.args[0]),
+                                          Args.size() - 1, _syscall_operands.size(), DecodeFormat(Args)});
+                for (size_t i = 1; i < Args.size(); ++i) {
+                    _syscall_operands.push_back(Args[i].is_reg
+                                                    ? SyscallOperand{DecodeRegister(Args[i]), true}
+                                                    : SyscallOperand{Args[i].to<long>(), false});
+                }
+                break;
+
+            case OpCode::NOP:
+            case OpCode::SNAP_SAVE:
+            case OpCode::SNAP_SWAP:
+            case OpCode::SNAP_CLEAR:
+            case OpCode::REGS_CLEAR:
+            case OpCode::SNAP_PUSH:
+            case OpCode::SNAP_POP:
+            case OpCode::HALT:
+                break;
+
+            default:
+                throw std::runtime_error("Unknown instruction");
+        }
+
+        _decoded.push_back(decoded);
+    }
+
+    DecodedInstruction end;
+    end.code = OpCode::END;
+    _decoded.push_back(end);
+
+    if (_fusion_enabled) Fuse();
+}
+
+void VMAsm::Program::Fuse() {
+    struct Pattern {
+        OpCode fused;
+        std::vector<OpCode> sequence;
+        const char *name;
+    };
+
+    // 较长的序列优先匹配
+    static const Pattern patterns[] = {
+        {OpCode::ADD_SUB_JNZ, {OpCode::ADD, OpCode::SUB, OpCode::JNZ}, "add+sub+jnz"},
+        {OpCode::SUB_JZ, {OpCode::SUB, OpCode::JZ}, "sub+jz"},
+        {OpCode::SUB_JNZ, {OpCode::SUB, OpCode::JNZ}, "sub+jnz"},
+        {OpCode::SUB_JG, {OpCode::SUB, OpCode::JG}, "sub+jg"},
+        {OpCode::MOV_MOV, {OpCode::MOV, OpCode::MOV}, "mov+mov"},
+        {OpCode::MOV_ADD, {OpCode::MOV, OpCode::ADD}, "mov+add"},
+        {OpCode::ADD_ADD, {OpCode::ADD, OpCode::ADD}, "add+add"},
+    };
+
+    // 条件跳转必须测试紧邻其前的 sub 所写入的寄存器, 处理函数才能直接使用计算结果
+    auto tests_result = [](const DecodedInstruction &sub, const DecodedInstruction &jump) {
+        return jump.kinds[0] == OperandKind::Register && jump.args[0] == sub.args[2];
+    };
+
+    std::vector<size_t> sites(std::size(patterns));
+    const size_t count = _instructions.size();
+
+    // 每个位置独立匹配: 组内指令保持原样, 因此位置 i 与 i + 1 可以同时作为超级指令的起点
+    for (size_t i = 0; i < count; ++i) {
+        for (size_t p = 0; p < std::size(patterns); ++p) {
+            const auto &[fused, sequence, name] = patterns[p];
+            if (i + sequence.size() > count) continue;
+
+            bool match = true;
+            for (size_t k = 0; k < sequence.size() && match; ++k) {
+                match = _instructions[i + k].code == sequence[k];
+            }
+            if (!match) continue;
+
+            const size_t last = i + sequence.size() - 1;
+            if (sequence.back() == OpCode::JZ || sequence.back() == OpCode::JNZ || sequence.back() == OpCode::JG) {
+                if (!tests_result(_decoded[last - 1], _decoded[last])) continue;
+            }
+
+            _decoded[i].code = fused;
+            ++sites[p];
+            break;
+        }
+    }
+
+    for (size_t p = 0; p < std::size(patterns); ++p) {
+        if (sites[p] == 0) continue;
+        _fusion_stats.push_back({patterns[p].name, sites[p], patterns[p].sequence.size() - 1});
+    }
+}
@@ -29,85 +29,85 @@
 
 #include "vmasm/syscalls.hpp"
 
-#include <iostream>
-
+#include "vmasm/format.hpp"
 #include "vmasm/vm.hpp"
 
-#include <sstream>
+#include <charconv>
+#include <cstdio>
 #include <stdexcept>
 
-template<typename T>
-T getValueAs(const VMAsm::Value& arg, VMAsm::VirtualMachine* vm) {
-    if (arg.is_reg) {
-        return vm->GetRegisterValue(arg.to<uint8_t>()).to<T>();
+namespace {
+    void AppendArgument(std::string &output, const VMAsm::SyscallArgs &args, const size_t index, const char spec) {
+        char buffer[32];
+        switch (spec) {
+            case 'd': { // 整数
+                const auto result = std::to_chars(buffer, buffer + sizeof(buffer), args.GetLong(index));
+                output.append(buffer, result.ptr);
+                break;
+            }
+            case 'f': { // 浮点数, 与流输出的默认格式一致
+                const int length = std::snprintf(buffer, sizeof(buffer), "%g", args.GetDouble(index));
+                output.append(buffer, static_cast<size_t>(length));
+                break;
+            }
+            case 's': // 字符串
+                output.append(args.GetString(index));
+                break;
+            case 'c': // 字符
+                output.push_back(static_cast<char>(args.GetLong(index)));
+                break;
+            case 'x': { // 十六进制
+                const auto value = static_cast<unsigned long>(args.GetLong(index));
+                const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value, 16);
+                output.append(buffer, result.ptr);
+                break;
+            }
+            default:
+                break;
+        }
     }
-    return arg.to<T>();
 }
 
-void VMAsm::SysCallRegistry::SysPrint(VirtualMachine *vm, const std::vector<Value> &args) {
+void VMAsm::SysCallRegistry::SysPrint(VirtualMachine *vm, const SyscallArgs &args) {
     if (args.empty()) {
         throw std::runtime_error("printf requires format string");
     }
 
-    std::string fmt;
-    if (args[0].is_reg) {
-        fmt = vm->GetRegisterValue(args[0].to<uint8_t>()).to<std::string>();
-    } else {
-        fmt = args[0].to<std::string>();
+    // 常量格式串使用加载时的解析结果, 寄存器中的格式串每次解析
+    Format parsed;
+    const Format *format = args.GetFormat();
+    if (format == nullptr) {
+        parsed = Format::Parse(args.GetString(0));
+        format = &parsed;
     }
 
-    std::ostringstream output;
-    size_t arg_index = 1;
+    if (args.size() - 1 < format->GetArgumentCount()) {
+        throw std::runtime_error("Not enough arguments for format string");
+    }
 
-    for (size_t i = 0; i < fmt.size(); ++i) {
-        if (fmt[i] == '%' && i + 1 < fmt.size()) {
-            const char spec = fmt[++i];
-            if (arg_index >= args.size()) {
-                throw std::runtime_error("Not enough arguments for format string");
-            }
+    // 先拼出整行再写入虚拟机的输出缓冲, 缓冲区复用容量
+    thread_local std::string line;
+    line.clear();
 
-            const Value& arg = args[arg_index++];
-            switch (spec) {
-                case 'd': // 整数
-                    output << getValueAs<long>(arg, vm);
-                    break;
-                case 'f': // 浮点数
-                    output << getValueAs<double>(arg, vm);
-                    break;
-                case 's': // 字符串
-                    output << getValueAs<std::string>(arg, vm);
-                    break;
-                case 'c': // 字符
-                    output << static_cast<char>(getValueAs<int>(arg, vm));
-                    break;
-                case 'x': // 十六进制
-                    output << std::hex << getValueAs<long>(arg, vm) << std::dec;
-                    break;
-                case '%':
-                    output << '%';
-                    arg_index--;
-                    break;
-                default:
-                    throw std::runtime_error("Invalid format specifier: %" + std::string(1, spec));
-            }
-        } else {
-            output << fmt[i];
-        }
+    size_t index = 1;
+    for (const FormatPiece &piece : format->GetPieces()) {
+        if (piece.spec == 0) line.append(format->GetText(), piece.offset, piece.length);
+        else AppendArgument(line, args, index++, piece.spec);
     }
 
-    std::cout << output.str() << std::flush;
+    vm->Print(line);
 }
 
-void VMAsm::SysCallRegistry::SysExit(VirtualMachine *vm, const std::vector<Value> &args) {
-    auto& arg = args.at(0);
-    exit(arg.is_reg ? vm->GetRegisterValue(arg.to<uint8_t>()).to<int>() : arg.to<int>());
+void VMAsm::SysCallRegistry::SysExit(VirtualMachine *vm, const int code) {
+    // 只结束当前虚拟机, 不终止宿主进程
+    vm->Exit(code);
 }
 
-void VMAsm::SysCallRegistry::SysRand(VirtualMachine *vm, const std::vector<Value> &args) {
+void VMAsm::SysCallRegistry::SysRand(VirtualMachine *vm, const SyscallArgs &args) {
     Value rand;
 }
 
 void VMAsm::SysCallRegistry::Init(VirtualMachine *vm) {
     vm->RegisterSyscall(1, SysPrint);
-    vm->RegisterSyscall(2, SysExit);
+    vm->RegisterSyscall<&SysExit>(2);
 }
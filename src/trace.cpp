@@ -0,0 +1,97 @@
+/*******************************************************************************
+ * 文件名称: trace
+ * 项目名称: TEFModLoader
+ * 创建时间: 2026/10/16
+ * 作者: EternalFuture゙
+ * Github: https://github.com/eternalfuture-e38299
+ * 版权声明: Copyright © 2025 EternalFuture゙
+ * 
+ * MIT License
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+
+#include "vmasm/trace.hpp"
+
+#include <algorithm>
+#include <fstream>
+
+namespace {
+    constexpr char TraceMagic[4] = {'V', 'M', 'T', 'R'};
+    constexpr uint32_t TraceVersion = 1;
+}
+
+VMAsm::TraceBuffer::TraceBuffer(const size_t capacity) {
+    size_t size = 1;
+    while (size < capacity) size <<= 1;
+    _records.resize(size);
+    _mask = size - 1;
+}
+
+std::vector<VMAsm::TraceRecord> VMAsm::TraceBuffer::GetRecords() const {
+    std::vector<TraceRecord> records;
+    records.reserve(Size());
+    for (uint64_t i = _written - Size(); i < _written; ++i) records.push_back(_records[i & _mask]);
+    return records;
+}
+
+bool VMAsm::TraceBuffer::Save(const std::string &filename, const Program &program) const {
+    std::ofstream file(filename, std::ios::binary);
+    if (!file) return false;
+
+    const std::vector<TraceRecord> records = GetRecords();
+    const uint64_t instructions = static_cast<uint64_t>(program.Size());
+    const uint64_t count = records.size();
+
+    file.write(TraceMagic, sizeof(TraceMagic));
+    file.write(reinterpret_cast<const char *>(&TraceVersion), sizeof(TraceVersion));
+    file.write(reinterpret_cast<const char *>(&instructions), sizeof(instructions));
+    file.write(reinterpret_cast<const char *>(&_written), sizeof(_written));
+    file.write(reinterpret_cast<const char *>(&count), sizeof(count));
+    file.write(reinterpret_cast<const char *>(records.data()), static_cast<std::streamsize>(count * sizeof(TraceRecord)));
+    return static_cast<bool>(file);
+}
+
+bool VMAsm::TraceFile::Load(const std::string &filename, TraceFile &trace) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file) return false;
+
+    char magic[sizeof(TraceMagic)];
+    uint32_t version{};
+    uint64_t count{};
+    file.read(magic, sizeof(magic));
+    file.read(reinterpret_cast<char *>(&version), sizeof(version));
+    if (!file || !std::equal(magic, magic + sizeof(magic), TraceMagic) || version != TraceVersion) return false;
+
+    file.read(reinterpret_cast<char *>(&trace.instructions), sizeof(trace.instructions));
+    file.read(reinterpret_cast<char *>(&trace.written), sizeof(trace.written));
+    file.read(reinterpret_cast<char *>(&count), sizeof(count));
+    if (!file || count > trace.written) return false;
+
+    // 记录数必须与文件剩余长度一致, 防止损坏的文件头导致超大分配
+    const auto begin = file.tellg();
+    file.seekg(0, std::ios::end);
+    const auto remaining = static_cast<uint64_t>(file.tellg() - begin);
+    file.seekg(begin);
+    if (remaining != count * sizeof(TraceRecord)) return false;
+
+    trace.records.resize(count);
+    file.read(reinterpret_cast<char *>(trace.records.data()), static_cast<std::streamsize>(count * sizeof(TraceRecord)));
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,152 @@
+/*******************************************************************************
+ * 文件名称: verifier
+ * 项目名称: TEFModLoader
+ * 创建时间: 2026/10/16
+ * 作者: EternalFuture゙
+ * Github: https://github.com/eternalfuture-e38299
+ * 版权声明: Copyright © 2025 EternalFuture゙
+ * 
+ * MIT License
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *******************************************************************************/
+
+#include "vmasm/verifier.hpp"
+#include "vmasm/vm.hpp"
+
+#include <stdexcept>
+
+void VMAsm::Verifier::Verify(const std::vector<Instruction> &instructions,
+                             const std::unordered_map<std::string, long> &tables) {
+    // 跳转目标允许等于指令数: 末尾的标签指向解码映像的结束哨兵
+    const size_t size = instructions.size();
+    for (const auto &[name, address] : tables) {
+        if (address < 0 || static_cast<size_t>(address) > size) {
+            throw std::runtime_error("Table " + name + " points outside the program: " + std::to_string(address));
+        }
+    }
+
+    for (size_t pc = 0; pc < size; ++pc) {
+        VerifyInstruction(instructions[pc], pc, size);
+    }
+}
+
+void VMAsm::Verifier::VerifyInstruction(const Instruction &instruction, const size_t pc, const size_t size) {
+    const auto &[code, Args] = instruction;
+
+    auto arity = [&](const size_t count) {
+        if (Args.size() != count) {
+            Fail(pc, "expects " + std::to_string(count) + " operand(s), got " + std::to_string(Args.size()));
+        }
+    };
+
+    switch (code) {
+        case OpCode::JMP:
+            arity(1);
+            RequireTarget(Args[0], pc, 0, size);
+            break;
+
+        case OpCode::MOV:
+        case OpCode::NEG:
+            arity(2);
+            RequireOperand(Args[0], pc, 0);
+            RequireRegister(Args[1], pc, 1);
+            break;
+
+        case OpCode::ADD:
+        case OpCode::SUB:
+            arity(3);
+            RequireOperand(Args[0], pc, 0);
+            RequireOperand(Args[1], pc, 1);
+            RequireRegister(Args[2], pc, 2);
+            break;
+
+        case OpCode::JZ:
+        case OpCode::JNZ:
+        case OpCode::JG:
+        case OpCode::JL:
+            arity(2);
+            RequireOperand(Args[0], pc, 0);
+            RequireTarget(Args[1], pc, 1, size);
+            break;
+
+        case OpCode::SYS: {
+            if (Args.empty()) Fail(pc, "requires a call ID");
+            // 调用编号在解码时截断为一个字节, 超出范围的编号会被静默改写为别的调用
+            if (Args[0].is_reg || Args[0].is_table) Fail(pc, "call ID must be a constant");
+            const auto id = Args[0].to<long>();
+            if (id < 1 || id >= static_cast<long>(SyscallCount)) {
+                Fail(pc, "syscall ID out of range (1-" + std::to_string(SyscallCount - 1) + "): " +
+                         std::to_string(id));
+            }
+            for (size_t i = 1; i < Args.size(); ++i) RequireOperand(Args[i], pc, i);
+            break;
+        }
+
+        case OpCode::NOP:
+        case OpCode::SNAP_SAVE:
+        case OpCode::SNAP_SWAP:
+        case OpCode::SNAP_CLEAR:
+        case OpCode::REGS_CLEAR:
+        case OpCode::SNAP_PUSH:
+        case OpCode::SNAP_POP:
+        case OpCode::HALT:
+            arity(0);
+            break;
+
+        default:
+            // 结束哨兵与超级指令只由解码过程生成, 不允许出现在字节码中
+            Fail(pc, "unknown opcode " + std::to_string(static_cast<int>(code)));
+    }
+}
+
+void VMAsm::Verifier::RequireRegister(const Value &value, const size_t pc, const size_t index) {
+    if (!value.is_reg) Fail(pc, "operand " + std::to_string(index) + " must be a register");
+    RequireOperand(value, pc, index);
+}
+
+void VMAsm::Verifier::RequireOperand(const Value &value, const size_t pc, const size_t index) {
+    if (!value.is_reg) return;
+
+    // 按完整宽度读取, 避免 0x140 之类的下标截断成合法寄存器
+    const auto reg = value.to<long>();
+    if (value.data.empty() || value.data.size() > sizeof(long) || reg < 0 || reg >= 64) {
+        Fail(pc, "operand " + std::to_string(index) + " register index out of range: " + std::to_string(reg));
+    }
+}
+
+void VMAsm::Verifier::RequireTarget(const Value &value, const size_t pc, const size_t index, const size_t size) {
+    // 寄存器间接跳转在运行时取值, 越界时落到结束哨兵上
+    if (value.is_reg) {
+        RequireOperand(value, pc, index);
+        return;
+    }
+
+    // 未解析的标签以字符串保存, 读成整数是无意义的地址
+    if (value.data.size() != sizeof(long)) Fail(pc, "operand " + std::to_string(index) + " is not a jump target");
+
+    const auto target = value.to<long>();
+    if (target < 0 || static_cast<size_t>(target) > size) {
+        Fail(pc, "jump target out of range: " + std::to_string(target));
+    }
+}
+
+void VMAsm::Verifier::Fail(const size_t pc, const std::string &message) {
+    throw std::runtime_error("Instruction " + std::to_string(pc) + ": " + message);
+}
@@ -29,205 +29,768 @@
 
 #include "vmasm/vm.hpp"
 
+#include "vmasm/profiler.hpp"
+#include "vmasm/trace.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <iterator>
+#include <mutex>
 #include <stdexcept>
 
-int VMAsm::VirtualMachine::Interpreter(const Instruction &instruction) {
-    switch (instruction.code) {
-        // 基础指令
-        case OpCode::NOP:
-            break;
-
-        case OpCode::JMP: {
-            const auto target  = instruction.Args.at(0);
-            _program_counter =  target.is_reg ? _regs[target.to<uint8_t>()].to<long>() :
-            target.is_table ? _tables[target.to<std::string>()] : target.to<long>();
-        } break;
-
-        case OpCode::MOV: {
-            Value table;
-            const Value& src = instruction.Args.at(0);
-            const auto dst_reg = instruction.Args.at(1).to<uint8_t>();
-            _regs[dst_reg] =
-                src.is_reg ? _regs[src.to<uint8_t>()] :
-            src.is_table ? *table.write<long>(_tables[src.to<std::string>()]) : src;
-        } break;
-
-        case OpCode::ADD: {
-            const auto dst_reg = instruction.Args.at(2).to<uint8_t>();
-            const long val1 = instruction.Args.at(0).is_reg ?
-                _regs[instruction.Args.at(0).to<uint8_t>()].to<long>() :
-                instruction.Args.at(0).to<long>();
-            const long val2 = instruction.Args.at(1).is_reg ?
-                _regs[instruction.Args.at(1).to<uint8_t>()].to<long>() :
-                instruction.Args.at(1).to<long>();
-            _regs[dst_reg].write(val1 + val2);
-        } break;
-
-        case OpCode::SUB: {
-            const auto dst_reg = instruction.Args.at(2).to<uint8_t>();
-            const long val1 = instruction.Args.at(0).is_reg ?
-                _regs[instruction.Args.at(0).to<uint8_t>()].to<long>() :
-                instruction.Args.at(0).to<long>();
-            const long val2 = instruction.Args.at(1).is_reg ?
-                _regs[instruction.Args.at(1).to<uint8_t>()].to<long>() :
-                instruction.Args.at(1).to<long>();
-            _regs[dst_reg].write(val1 - val2);
-        } break;
-
-        case OpCode::NEG: {
-            const auto src_reg = instruction.Args.at(0).to<uint8_t>();
-            const auto dst_reg = instruction.Args.at(1).to<uint8_t>();
-            _regs[dst_reg].write(-_regs[src_reg].to<long>());
-        } break;
-
-        // 快照指令
-        case OpCode::SNAP_SAVE: {
-            _regs_snap = _regs;
-        } break;
-
-        case OpCode::SNAP_SWAP: {
-            std::swap(_regs, _regs_snap);
-        } break;
-
-        case OpCode::SNAP_CLEAR: {
-            _regs_snap.clear();
-            _regs_snap.resize(64);
-        } break;
-
-        case OpCode::REGS_CLEAR: {
-            _regs.clear();
-            _regs.resize(64);
-        } break;
-
-        // 控制指令
-        case OpCode::JZ: {
-            const auto& src = instruction.Args.at(0);
-            const long val = src.is_reg ?
-                _regs[src.to<uint8_t>()].to<long>() :
-                src.to<long>();
-            if (val == 0) {
-                const auto& target = instruction.Args.at(1);
-                _program_counter = target.is_reg ? _regs[target.to<uint8_t>()].to<long>() :
-                target.is_table ? _tables[target.to<std::string>()] : target.to<long>();
-            }
-        } break;
-
-        case OpCode::JNZ: {
-            const auto& src = instruction.Args.at(0);
-            const long val = src.is_reg ?
-                _regs[src.to<uint8_t>()].to<long>() :
-                src.to<long>();
-
-            if (val != 0) {
-                const auto& target = instruction.Args.at(1);
-                _program_counter = target.is_reg ? _regs[target.to<uint8_t>()].to<long>() :
-                target.is_table ? _tables[target.to<std::string>()] : target.to<long>();
-            }
-        } break;
-
-        case OpCode::JG: {
-            const auto& src = instruction.Args.at(0);
-            const long val = src.is_reg ?
-                _regs[src.to<uint8_t>()].to<long>() :
-                src.to<long>();
-
-            if (val > 0) {
-                const auto& target = instruction.Args.at(1);
-                _program_counter = target.is_reg ? _regs[target.to<uint8_t>()].to<long>() :
-                target.is_table ? _tables[target.to<std::string>()] : target.to<long>();
+#if defined(__GNUC__) || defined(__clang__)
+#define VMASM_HAS_COMPUTED_GOTO 1
+#else
+#define VMASM_HAS_COMPUTED_GOTO 0
+#endif
+
+VMAsm::DispatchMode VMAsm::VirtualMachine::DefaultDispatchMode() {
+#if defined(VMASM_THREADED_DISPATCH) && VMASM_HAS_COMPUTED_GOTO
+    return DispatchMode::Threaded;
+#else
+    return DispatchMode::Switch;
+#endif
+}
+
+void VMAsm::VirtualMachine::ResetJit() {
+    // 程序变化后旧代码全部失效
+    _jit->Reset();
+    const Program &program = *_program;
+    _jit_slots.assign(program.GetDecoded().size(), JitSlot{});
+
+    // 区域只从跳转目标与表入口开始, 它们是循环头与函数入口的候选
+    auto mark = [&](const long target) {
+        if (target >= 0 && target < program.Size()) _jit_slots[target].heat = _jit_threshold;
+    };
+    for (const auto &[name, target] : program.GetTables()) mark(target);
+    for (long pc = 0; pc < program.Size(); ++pc) {
+        const DecodedInstruction &ins = program.GetDecoded()[pc];
+        for (int i = 0; i < 3; ++i) {
+            if (ins.kinds[i] == OperandKind::Target) mark(ins.args[i]);
+        }
+    }
+}
+
+bool VMAsm::VirtualMachine::SetProfilingEnabled(const bool enabled) {
+#ifdef VMASM_PROFILE
+    if (enabled == (_profile != nullptr)) return true;
+    _profile = enabled ? std::make_unique<Profile>() : nullptr;
+    _dirty = true;
+    return true;
+#else
+    return !enabled;
+#endif
+}
+
+void VMAsm::VirtualMachine::StartTrace(const size_t capacity, const std::string &path) {
+    _trace = std::make_unique<TraceBuffer>(capacity);
+    _trace_path = path;
+    if (!_tracing) _dirty = true;
+    _tracing = true;
+}
+
+void VMAsm::VirtualMachine::StopTrace() {
+    if (_tracing) _dirty = true;
+    _tracing = false;
+}
+
+bool VMAsm::VirtualMachine::DumpTrace(const std::string &path) {
+    return _trace && _trace->Save(path, *GetProgram());
+}
+
+void VMAsm::VirtualMachine::ResetProfile() {
+    if (_profile) _profile->Reset(_program->Size());
+}
+
+bool VMAsm::VirtualMachine::SetJitEnabled(const bool enabled) {
+    if (!enabled) {
+        _jit.reset();
+        _jit_slots.clear();
+        return true;
+    }
+    if (!JitCompiler::IsSupported()) return false;
+    if (!_jit) {
+        _jit = std::make_shared<JitCompiler>();
+        _dirty = true;
+    }
+    return true;
+}
+
+VMAsm::VirtualMachine::Builder &VMAsm::VirtualMachine::Edit() {
+    // 共享的程序不可修改, 第一次编辑时把内容复制到私有的暂存区
+    if (!_building) {
+        _builder.instructions = _program->GetInstructions();
+        _builder.tables = _program->GetTables();
+        _building = true;
+    }
+    _dirty = true;
+    return _builder;
+}
+
+void VMAsm::VirtualMachine::Attach(std::shared_ptr<const Program> program) {
+    _program = program ? std::move(program) : Program::Empty();
+    _builder = Builder{};
+    _building = false;
+    _dirty = true;
+    _syscalls_checked = false;
+}
+
+void VMAsm::VirtualMachine::Prepare() {
+    if (!_dirty) return;
+
+    // 剖析与跟踪的记录需要与源指令一一对应, 不使用超级指令
+    const bool fusion = _fusion_enabled && !_profile && !_tracing;
+    if (_building) {
+        _program = Program::Create(std::move(_builder.instructions), std::move(_builder.tables), fusion);
+        _builder = Builder{};
+        _building = false;
+    } else if (_program->IsFusionEnabled() != fusion) {
+        // 融合设置与共享程序不同, 为本机生成一份私有映像
+        _program = Program::Create(_program->GetInstructions(), _program->GetTables(), fusion);
+    }
+
+    if (_jit) ResetJit();
+    if (_profile) _profile->Reset(_program->Size());
+    _dirty = false;
+    _syscalls_checked = false;
+}
+
+long VMAsm::VirtualMachine::Load(const DecodedInstruction &instruction, const int index) const {
+    return instruction.kinds[index] == OperandKind::Register
+               ? ReadLong(_regs[instruction.args[index]])
+               : instruction.args[index];
+}
+
+void VMAsm::VirtualMachine::ReleaseBank(const uint32_t bank) {
+    if (--_banks[bank].refs != 0) return;
+
+    // 空闲组总是保持清空状态, 取出时无需再初始化
+    Clear(_banks[bank].regs);
+    _free_banks.push_back(bank);
+}
+
+void VMAsm::VirtualMachine::BindLive() {
+    _regs = _banks[_live].regs.data();
+    _live_shared = _banks[_live].refs > 1;
+}
+
+void VMAsm::VirtualMachine::Unshare() {
+    if (_banks[_live].refs == 1) {
+        _live_shared = false;
+        return;
+    }
+
+    uint32_t bank;
+    if (!_free_banks.empty()) {
+        bank = _free_banks.back();
+        _free_banks.pop_back();
+    } else {
+        bank = static_cast<uint32_t>(_banks.size());
+        _banks.emplace_back();
+    }
+
+    // deque 扩容不会移动已有元素, 两个引用在此期间都有效
+    const Bank &source = _banks[_live];
+    Bank &copy = _banks[bank];
+    // 新组来自空闲列表或刚创建, 必然为空, 整组复制后只需补上堆块引用
+    copy.regs = source.regs;
+    for (const auto &reg : copy.regs) Retain(reg);
+    copy.refs = 1;
+
+    ReleaseBank(_live);
+    _live = bank;
+    BindLive();
+}
+
+VMAsm::Register &VMAsm::VirtualMachine::Dst(const long index) {
+    if (_live_shared) Unshare();
+    return _regs[index];
+}
+
+void VMAsm::VirtualMachine::SaveSnapshot() {
+    ++_banks[_live].refs;
+    ReleaseBank(_snapshots.back());
+    _snapshots.back() = _live;
+    _live_shared = true;
+}
+
+void VMAsm::VirtualMachine::SwapSnapshot() {
+    std::swap(_live, _snapshots.back());
+    BindLive();
+}
+
+void VMAsm::VirtualMachine::ClearSnapshot() {
+    ReleaseBank(_snapshots.back());
+    _snapshots.back() = AcquireEmptyBank();
+}
+
+void VMAsm::VirtualMachine::ClearRegisters() {
+    ReleaseBank(_live);
+    _live = AcquireEmptyBank();
+    BindLive();
+}
+
+void VMAsm::VirtualMachine::PushSnapshot() {
+    ++_banks[_live].refs;
+    _snapshots.push_back(_live);
+    _live_shared = true;
+}
+
+bool VMAsm::VirtualMachine::PopSnapshot() {
+    // 栈底是 snap_save 使用的快照, 不能被弹出
+    if (_snapshots.size() < 2) return false;
+
+    ReleaseBank(_live);
+    _live = _snapshots.back();
+    _snapshots.pop_back();
+    BindLive();
+    return true;
+}
+
+uint32_t VMAsm::VirtualMachine::AllocBlob(const uint8_t *data, const size_t size) {
+    uint32_t id;
+    if (!_free_blobs.empty()) {
+        id = _free_blobs.back();
+        _free_blobs.pop_back();
+    } else {
+        id = static_cast<uint32_t>(_blobs.size());
+        _blobs.emplace_back();
+    }
+
+    // 复用已释放块的容量, 稳定运行后不再触发分配
+    Blob &blob = _blobs[id];
+    blob.data.assign(data, data + size);
+    blob.refs = 1;
+    return id;
+}
+
+void VMAsm::VirtualMachine::Retain(const Register &reg) {
+    if (reg.tag == RegisterTag::Heap) ++_blobs[reg.bits].refs;
+}
+
+void VMAsm::VirtualMachine::Release(Register &reg) {
+    if (reg.tag == RegisterTag::Heap && --_blobs[reg.bits].refs == 0) {
+        _free_blobs.push_back(static_cast<uint32_t>(reg.bits));
+    }
+    reg = Register{};
+}
+
+void VMAsm::VirtualMachine::Assign(Register &dst, const Register &src) {
+    if (&dst == &src) return;
+    Retain(src);
+    if (dst.tag == RegisterTag::Heap) Release(dst);
+
+    // 逐字段复制: 整块 16 字节的读取跨越了之前的窄写入, 会导致存储转发失败
+    dst.bits = src.bits;
+    dst.size = src.size;
+    dst.tag = src.tag;
+}
+
+void VMAsm::VirtualMachine::Write(Register &dst, const long value) {
+    if (dst.tag == RegisterTag::Heap) Release(dst);
+    dst.bits = static_cast<uint64_t>(value);
+    dst.size = sizeof(long);
+    dst.tag = RegisterTag::Inline;
+}
+
+void VMAsm::VirtualMachine::Write(Register &dst, const Value &value) {
+    Release(dst);
+    if (value.data.empty()) return;
+
+    dst.size = static_cast<uint32_t>(value.data.size());
+    if (value.data.size() <= sizeof(dst.bits)) {
+        std::memcpy(&dst.bits, value.data.data(), value.data.size());
+        dst.tag = RegisterTag::Inline;
+    } else {
+        dst.bits = AllocBlob(value.data.data(), value.data.size());
+        dst.tag = RegisterTag::Heap;
+    }
+}
+
+void VMAsm::VirtualMachine::Clear(RegisterFile &regs) {
+    for (auto &reg : regs) Release(reg);
+}
+
+VMAsm::Value VMAsm::VirtualMachine::ReadValue(const Register &reg) const {
+    Value value{};
+    if (reg.tag == RegisterTag::Inline) {
+        const auto *bytes = reinterpret_cast<const uint8_t *>(&reg.bits);
+        value.data.assign(bytes, bytes + reg.size);
+    } else if (reg.tag == RegisterTag::Heap) {
+        value.data = _blobs[reg.bits].data;
+    }
+    return value;
+}
+
+long VMAsm::VirtualMachine::Branch(const DecodedInstruction &instruction, const int index) const {
+    if (instruction.kinds[index] != OperandKind::Register) return instruction.args[index];
+
+    // 寄存器间接跳转在运行时才知道目标, 越界时落到末尾哨兵上结束执行
+    const long target = ReadLong(_regs[instruction.args[index]]);
+    const long end = _program->Size();
+    return static_cast<unsigned long>(target) < static_cast<unsigned long>(end) ? target : end;
+}
+
+void VMAsm::VirtualMachine::ExecMov(const DecodedInstruction &instruction) {
+    Register &dst = Dst(instruction.args[1]);
+    switch (instruction.kinds[0]) {
+        case OperandKind::Register: Assign(dst, _regs[instruction.args[0]]); break;
+        case OperandKind::Constant: Write(dst, _program->GetConstants()[instruction.args[0]]); break;
+        default: Write(dst, instruction.args[0]); break;
+    }
+}
+
+long VMAsm::VirtualMachine::ExecAdd(const DecodedInstruction &instruction) {
+    const long value = Load(instruction, 0) + Load(instruction, 1);
+    Write(Dst(instruction.args[2]), value);
+    return value;
+}
+
+long VMAsm::VirtualMachine::ExecSub(const DecodedInstruction &instruction) {
+    const long value = Load(instruction, 0) - Load(instruction, 1);
+    Write(Dst(instruction.args[2]), value);
+    return value;
+}
+
+void VMAsm::VirtualMachine::Syscall(const uint8_t id, const long site) {
+    const SyscallSlot &slot = _syscalls[id];
+    if (!slot.function && !slot.method) throw std::runtime_error("Undefined syscall: " + std::to_string(id));
+
+    // 第一个操作数是调用编号, 其余原样交给处理函数
+    const SyscallSite &info = _program->GetSyscallSites()[site];
+    const SyscallArgs args(this, _program->GetInstructions()[info.index].Args.data() + 1,
+                           _program->GetSyscallOperands().data() + info.operands, info.arguments,
+                           info.format >= 0 ? &_program->GetFormats()[info.format] : nullptr);
+    try {
+#ifdef VMASM_PROFILE
+        if (_profile) {
+            const auto begin = std::chrono::steady_clock::now();
+            if (slot.function) slot.function(this, args);
+            else slot.method(this, args);
+            const auto end = std::chrono::steady_clock::now();
+
+            SyscallProfile &profile = _profile->syscalls[id];
+            profile.calls++;
+            profile.nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+            return;
+        }
+#endif
+        if (slot.function) slot.function(this, args);
+        else slot.method(this, args);
+    } catch (const std::exception& e) {
+        throw std::runtime_error(std::string("Syscall ") +
+                               std::to_string(id) +
+                               " failed: " + e.what());
+    }
+}
+
+int VMAsm::VirtualMachine::RunSwitch(const long start, const uint64_t budget) {
+    const DecodedInstruction *code = _program->GetDecoded().data();
+    const DecodedInstruction *ins;
+    long pc = start;
+    long seg = start;       // 当前顺序执行段的起点
+    uint64_t retired = 0;   // 已结算的指令数
+    int status;
+
+#define VMASM_OP(name) case OpCode::name:
+#define VMASM_NEXT() break
+#define VMASM_EXIT(result) do { status = (result); goto done; } while (0)
+#define VMASM_JUMP(target) do { retired += pc - seg; pc = (target); seg = pc; if (retired >= budget) VMASM_EXIT(StatusYielded); } while (0)
+
+    for (;;) {
+        ins = &code[pc++];
+        switch (ins->code) {
+#include "vm_handlers.inc"
+            default:
+                throw std::runtime_error("Unknown instruction");
+        }
+    }
+
+#undef VMASM_OP
+#undef VMASM_NEXT
+#undef VMASM_EXIT
+#undef VMASM_JUMP
+
+done:
+    _program_counter = pc;
+    _retired += retired + (pc - seg);
+    return status;
+}
+
+int VMAsm::VirtualMachine::RunThreaded(const long start, const uint64_t budget) {
+#if VMASM_HAS_COMPUTED_GOTO
+    // 每个处理函数末尾直接跳转到下一条指令的处理函数, 省去回到中心 switch 的分派开销
+    static const void *const dispatch_table[] = {
+        &&op_NOP, &&op_JMP, &&op_MOV, &&op_ADD, &&op_SUB, &&op_NEG,
+        &&op_SNAP_SAVE, &&op_SNAP_SWAP, &&op_SNAP_CLEAR, &&op_REGS_CLEAR,
+        &&op_JZ, &&op_JNZ, &&op_JG, &&op_JL,
+        &&op_HALT, &&op_SYS,
+        &&op_SNAP_PUSH, &&op_SNAP_POP,
+        &&op_END,
+        &&op_MOV_MOV, &&op_MOV_ADD, &&op_ADD_ADD,
+        &&op_SUB_JZ, &&op_SUB_JNZ, &&op_SUB_JG, &&op_ADD_SUB_JNZ,
+    };
+    static_assert(std::size(dispatch_table) == static_cast<size_t>(OpCode::ADD_SUB_JNZ) + 1,
+                  "dispatch_table must cover every OpCode");
+
+    const DecodedInstruction *code = _program->GetDecoded().data();
+    const DecodedInstruction *ins;
+    long pc = start;
+    long seg = start;       // 当前顺序执行段的起点
+    uint64_t retired = 0;   // 已结算的指令数
+    int status;
+
+#define VMASM_OP(name) op_##name:
+#define VMASM_NEXT() do { ins = &code[pc++]; goto *dispatch_table[static_cast<uint8_t>(ins->code)]; } while (0)
+#define VMASM_EXIT(result) do { status = (result); goto done; } while (0)
+#define VMASM_JUMP(target) do { retired += pc - seg; pc = (target); seg = pc; if (retired >= budget) VMASM_EXIT(StatusYielded); } while (0)
+
+    VMASM_NEXT();
+#include "vm_handlers.inc"
+
+#undef VMASM_OP
+#undef VMASM_NEXT
+#undef VMASM_EXIT
+#undef VMASM_JUMP
+
+done:
+    _program_counter = pc;
+    _retired += retired + (pc - seg);
+    return status;
+#else
+    return RunSwitch(start, budget);
+#endif
+}
+
+int VMAsm::VirtualMachine::RunJit(const long start, const uint64_t budget) {
+    const DecodedInstruction *code = _program->GetDecoded().data();
+    JitSlot *slots = _jit_slots.data();
+    const DecodedInstruction *ins;
+    long pc = start;
+    long seg = start;       // 当前顺序执行段的起点
+    uint64_t retired = 0;   // 已结算的指令数
+    int status;
+    bool bailed = false;
+
+#define VMASM_OP(name) case OpCode::name:
+#define VMASM_NEXT() break
+#define VMASM_EXIT(result) do { status = (result); goto done; } while (0)
+#define VMASM_JUMP(target) do { retired += pc - seg; pc = (target); seg = pc; if (retired >= budget) VMASM_EXIT(StatusYielded); } while (0)
+
+    for (;;) {
+        // 守卫失败后必须先解释执行一条指令, 否则会反复进入同一区域
+        if (!bailed) {
+            JitSlot &slot = slots[pc];
+            if (slot.function) {
+                if (_live_shared) Unshare();
+                retired += pc - seg;
+                const long next = slot.function(_regs, &retired, retired < budget ? budget - retired : 0);
+                bailed = next == pc;
+                pc = seg = next;
+                if (retired >= budget) VMASM_EXIT(StatusYielded);
+                continue;
             }
-        } break;
-
-        case OpCode::JL: {
-            const auto& src = instruction.Args.at(0);
-            const long val = src.is_reg ?
-                _regs[src.to<uint8_t>()].to<long>() :
-                src.to<long>();
-
-            if (val < 0) {
-                const auto& target = instruction.Args.at(1);
-                _program_counter = target.is_reg ? _regs[target.to<uint8_t>()].to<long>() :
-                target.is_table ? _tables[target.to<std::string>()] : target.to<long>();
+            if (slot.heat != 0 && --slot.heat == 0) {
+                slot.function = _jit->Compile(_program->GetInstructions(), _program->GetDecoded(), pc);
+                if (slot.function) continue;
             }
-        } break;
+        }
+        bailed = false;
 
-        // 系统指令
-        case OpCode::HALT: {
-            return 1; // 停止执行
+        ins = &code[pc++];
+        switch (ins->code) {
+#include "vm_handlers.inc"
+            default:
+                throw std::runtime_error("Unknown instruction");
         }
+    }
 
-        case OpCode::SYS: {
-            if (instruction.Args.empty()) {
-                throw std::runtime_error("SYS call requires at least call ID");
-            }
+#undef VMASM_OP
+#undef VMASM_NEXT
+#undef VMASM_EXIT
+#undef VMASM_JUMP
+
+done:
+    _program_counter = pc;
+    _retired += retired + (pc - seg);
+    return status;
+}
 
-            const auto syscall_id = instruction.Args[0].to<uint8_t>();
-            std::vector<Value> args;
-
-            for (size_t i = 1; i < instruction.Args.size(); ++i) args.push_back(instruction.Args[i]);
-
-            if (const auto it = SyscallTable.find(syscall_id); it != SyscallTable.end()) {
-                try {
-                    it->second(this, args);
-                } catch (const std::exception& e) {
-                    throw std::runtime_error(std::string("Syscall ") +
-                                           std::to_string(syscall_id) +
-                                           " failed: " + e.what());
-                }
-            } else {
-                throw std::runtime_error("Undefined syscall: " + std::to_string(syscall_id));
+int VMAsm::VirtualMachine::RunProfiled(const long start, const uint64_t budget) {
+#ifdef VMASM_PROFILE
+    // 与 RunSwitch 相同, 只在分派前计数, 末尾哨兵不计入
+    const DecodedInstruction *code = _program->GetDecoded().data();
+    uint64_t *counts = _profile->instructions.data();
+    uint64_t *opcodes = _profile->opcodes.data();
+    const long end = _program->Size();
+    const DecodedInstruction *ins;
+    long pc = start;
+    long seg = start;       // 当前顺序执行段的起点
+    uint64_t retired = 0;   // 已结算的指令数
+    int status;
+
+#define VMASM_OP(name) case OpCode::name:
+#define VMASM_NEXT() break
+#define VMASM_EXIT(result) do { status = (result); goto done; } while (0)
+#define VMASM_JUMP(target) do { retired += pc - seg; pc = (target); seg = pc; if (retired >= budget) VMASM_EXIT(StatusYielded); } while (0)
+
+    for (;;) {
+        ins = &code[pc];
+        if (pc < end) {
+            counts[pc]++;
+            opcodes[static_cast<uint8_t>(ins->code)]++;
+        }
+        pc++;
+        switch (ins->code) {
+#include "vm_handlers.inc"
+            default:
+                throw std::runtime_error("Unknown instruction");
+        }
+    }
+
+#undef VMASM_OP
+#undef VMASM_NEXT
+#undef VMASM_EXIT
+#undef VMASM_JUMP
+
+done:
+    _program_counter = pc;
+    _retired += retired + (pc - seg);
+    return status;
+#else
+    return RunSwitch(start, budget);
+#endif
+}
+
+int VMAsm::VirtualMachine::RunTraced(const long start, const uint64_t budget) {
+    // 与 RunSwitch 相同, 分派前写入一条记录, 目标寄存器的值在下一条指令分派前 (或退出时) 补上
+    const DecodedInstruction *code = _program->GetDecoded().data();
+    TraceBuffer &trace = *_trace;
+    TraceRecord *last = nullptr;
+    const DecodedInstruction *ins;
+    long pc = start;
+    long seg = start;       // 当前顺序执行段的起点
+    uint64_t retired = 0;   // 已结算的指令数
+    int status;
+
+    auto settle = [this, &last] {
+        if (last && last->reg != TraceNoRegister) last->value = static_cast<uint64_t>(ReadLong(_regs[last->reg]));
+        last = nullptr;
+    };
+
+#define VMASM_OP(name) case OpCode::name:
+#define VMASM_NEXT() break
+#define VMASM_EXIT(result) do { status = (result); goto done; } while (0)
+#define VMASM_JUMP(target) do { retired += pc - seg; pc = (target); seg = pc; if (retired >= budget) VMASM_EXIT(StatusYielded); } while (0)
+
+    for (;;) {
+        settle();
+        ins = &code[pc];
+        if (ins->code != OpCode::END) {
+            last = &trace.Append();
+            last->pc = static_cast<uint32_t>(pc);
+            last->code = ins->code;
+            last->value = 0;
+            switch (ins->code) {
+                case OpCode::MOV:
+                case OpCode::NEG: last->reg = static_cast<uint8_t>(ins->args[1]); break;
+                case OpCode::ADD:
+                case OpCode::SUB: last->reg = static_cast<uint8_t>(ins->args[2]); break;
+                default: last->reg = TraceNoRegister; break;
             }
-        } break;
+        }
+        pc++;
+        switch (ins->code) {
+#include "vm_handlers.inc"
+            default:
+                throw std::runtime_error("Unknown instruction");
+        }
+    }
+
+#undef VMASM_OP
+#undef VMASM_NEXT
+#undef VMASM_EXIT
+#undef VMASM_JUMP
 
-        default:
-            throw std::runtime_error("Unknown instruction");
+done:
+    settle();
+    _program_counter = pc;
+    _retired += retired + (pc - seg);
+    return status;
+}
+
+int VMAsm::VirtualMachine::Run(long start, const uint64_t budget) {
+    Prepare();
+    if (!_syscalls_checked) CheckSyscalls();
+
+    // 持有一份引用: 系统调用中重新挂载程序时, 正在执行的映像不会被释放
+    const std::shared_ptr<const Program> program = _program;
+    _stop_request = StopRequest::None;
+    _status = StatusEnd;
+
+    // 解码映像末尾总有一个 END 哨兵, 越界的入口直接落在哨兵上
+    const long end = _program->Size();
+    if (static_cast<unsigned long>(start) > static_cast<unsigned long>(end)) start = end;
+
+    int status;
+    try {
+        if (_tracing) status = RunTraced(start, budget);
+        else if (_profile) status = RunProfiled(start, budget);
+        else if (_jit) status = RunJit(start, budget);
+        else if (_dispatch_mode == DispatchMode::Threaded) status = RunThreaded(start, budget);
+        else status = RunSwitch(start, budget);
+    } catch (...) {
+        FlushOutput();
+        if (_tracing && !_trace_path.empty()) _trace->Save(_trace_path, *_program);
+        throw;
+    }
+
+    _status = status;
+    if (status == StatusEnd || status == StatusHalt) FlushOutput();
+    if (status == StatusHalt && _tracing && !_trace_path.empty()) _trace->Save(_trace_path, *_program);
+    return status;
+}
+
+VMAsm::VirtualMachine::VirtualMachine() = default;
+
+VMAsm::VirtualMachine::~VirtualMachine() {
+    try {
+        FlushOutput();
+    } catch (...) {
+        // 析构时无法报告输出失败
     }
-    return 0;
 }
 
-int VMAsm::VirtualMachine::Run(const long start) {
-    _program_counter = start;
-    auto it = _instructions.begin();
-    while (it != _instructions.end()) {
-        if (const int result = Interpreter(*it); result != 0) return result;
+void VMAsm::VirtualMachine::SetOutput(OutputWriter writer, const size_t buffer) {
+    FlushOutput();
+    _output_writer = std::move(writer);
+    _output_limit = buffer;
+}
+
+void VMAsm::VirtualMachine::Print(const std::string_view text) {
+    _output.append(text);
+    if (_output.size() >= _output_limit) FlushOutput();
+}
 
+void VMAsm::VirtualMachine::FlushOutput() {
+    if (_output.empty()) return;
 
-        // ReSharper disable once CppDFAConstantConditions
-        if (_program_counter != start) {
-            it = std::next(_instructions.begin(), _program_counter);
-            _program_counter = start;
+    try {
+        if (_output_writer) {
+            _output_writer(_output);
         } else {
-            // ReSharper disable once CppDFAUnreachableCode
-            ++it;
+            // 多个虚拟机可能在不同线程中同时输出, 整段写入以免交错
+            static std::mutex lock;
+            std::lock_guard guard(lock);
+            std::cout.write(_output.data(), static_cast<std::streamsize>(_output.size()));
+            std::cout.flush();
         }
+    } catch (...) {
+        _output.clear();
+        throw;
     }
-    return 0;
+    _output.clear();
 }
 
 bool VMAsm::VirtualMachine::RegisterSyscall(const int id, const VirtualMethod &method) {
-    if (id == 0) return false;
-    SyscallTable[id] = method;
+    if (const auto *function = method.target<SyscallFunction>()) return RegisterSyscall(id, *function, -1);
+    if (id <= 0 || id >= static_cast<int>(SyscallCount)) return false;
+
+    _syscalls[id] = SyscallSlot{nullptr, method, -1};
+    _syscalls_checked = false;
+    return true;
+}
+
+bool VMAsm::VirtualMachine::RegisterSyscall(const int id, const SyscallFunction function, const int arity) {
+    if (id <= 0 || id >= static_cast<int>(SyscallCount) || !function) return false;
+
+    _syscalls[id] = SyscallSlot{function, nullptr, arity};
+    _syscalls_checked = false;
     return true;
 }
 
+void VMAsm::VirtualMachine::CheckSyscalls() {
+    // 只核对已注册且参数个数固定的调用, 未注册的编号仍在执行到时报错
+    for (const SyscallSite &site : _program->GetSyscallSites()) {
+        const int arity = _syscalls[site.id].arity;
+        if (arity < 0 || site.arguments == static_cast<size_t>(arity)) continue;
+
+        throw std::runtime_error("Syscall " + std::to_string(site.id) + " expects " + std::to_string(arity) +
+                                 " argument(s), got " + std::to_string(site.arguments) +
+                                 " at instruction " + std::to_string(site.index));
+    }
+    _syscalls_checked = true;
+}
+
+bool VMAsm::VirtualMachine::HasSyscall(const int id) const {
+    if (id <= 0 || id >= static_cast<int>(SyscallCount)) return false;
+    return _syscalls[id].function || _syscalls[id].method;
+}
+
 int VMAsm::VirtualMachine::Execute(const std::string &table) {
-    return Run(_tables[table]);
+    return Execute(table, Unlimited);
+}
+
+int VMAsm::VirtualMachine::Execute(const std::string &table, const uint64_t budget) {
+    Prepare();
+
+    // 只读查找, 不会修改共享的符号表; 入口不存在时与以往一样从 0 开始执行
+    const long entry = _program->FindTable(table);
+    return Run(entry < 0 ? 0 : entry, budget);
+}
+
+int VMAsm::VirtualMachine::Resume(const uint64_t budget) {
+    if (_status != StatusYielded && _status != StatusSuspended) {
+        throw std::runtime_error("Resume: the virtual machine is not paused");
+    }
+    return Run(_program_counter, budget);
 }
 
 void VMAsm::VirtualMachine::AddInstruction(const Instruction& instruction) {
-    _instructions.push_back(instruction);
+    Edit().instructions.push_back(instruction);
 }
 
 void VMAsm::VirtualMachine::SetRegisterValue(const uint8_t register_index, const Value &value) {
-    if (register_index >= _regs.size()) {
+    if (register_index >= RegisterCount) {
+        throw std::out_of_range("Register index out of range");
+    }
+    Write(Dst(register_index), value);
+}
+
+void VMAsm::VirtualMachine::SetRegisterValue(const uint8_t register_index, const long value) {
+    if (register_index >= RegisterCount) {
         throw std::out_of_range("Register index out of range");
     }
-    _regs[register_index] = value;
+    Write(Dst(register_index), value);
 }
 
 VMAsm::Value VMAsm::VirtualMachine::GetRegisterValue(const uint8_t register_index) {
-    if (register_index >= _regs.size()) {
+    if (register_index >= RegisterCount) {
         throw std::out_of_range("Register index out of range");
     }
-    return _regs[register_index];
-}
\ No newline at end of file
+    return ReadValue(_regs[register_index]);
+}
+
+const VMAsm::Value &VMAsm::SyscallArgs::at(const size_t index) const {
+    if (index >= _size) throw std::out_of_range("Syscall argument index out of range");
+    return _values[index];
+}
+
+std::string_view VMAsm::SyscallArgs::GetString(const size_t index) const {
+    const ByteSpan bytes = GetBytes(index);
+    const auto *data = reinterpret_cast<const char *>(bytes.data);
+
+    // 与 Value::to<std::string> 一致: 以 '\0' 结尾时按 C 字符串读取, 否则取全部字节
+    if (bytes.size != 0 && data[bytes.size - 1] == '\0') return {data, std::strlen(data)};
+    return {data, bytes.size};
+}
+
+VMAsm::ByteSpan VMAsm::SyscallArgs::GetBytes(const size_t index) const {
+    const SyscallOperand &operand = Operand(index);
+    if (!operand.is_reg) return {_values[index].data.data(), _values[index].data.size()};
+
+    const Register &value = _vm->_regs[operand.value];
+    if (value.tag == RegisterTag::Inline) return {reinterpret_cast<const uint8_t *>(&value.bits), value.size};
+    if (value.tag == RegisterTag::Heap) return {_vm->_blobs[value.bits].data.data(), _vm->_blobs[value.bits].data.size()};
+    return {};
+}
@@ -28,20 +28,40 @@
  *******************************************************************************/
 
 #include "vmasm/vm_serializer.hpp"
+#include "vmasm/verifier.hpp"
 #include "vmasm/vm.hpp"
 
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
 #include <fstream>
+#include <stdexcept>
 
 void VMAsm::VMSerializer::WriteSizedData(std::ofstream& file, const void* data, const uint32_t size) {
     file.write(reinterpret_cast<const char*>(&size), sizeof(size));
     if (size > 0) file.write(static_cast<const char*>(data), size);
 }
 
-std::vector<uint8_t> VMAsm::VMSerializer::ReadSizedData(std::ifstream& file) {
+namespace {
+
+    // 定长字段的读取: 先对照剩余字节数, 再检查流状态
+    void ReadExact(std::ifstream &file, void *out, const size_t size, uint64_t &remaining) {
+        if (size > remaining) throw std::runtime_error("Malformed bytecode: unexpected end of file");
+        file.read(static_cast<char *>(out), static_cast<std::streamsize>(size));
+        if (!file) throw std::runtime_error("Malformed bytecode: unexpected end of file");
+        remaining -= size;
+    }
+
+}
+
+std::vector<uint8_t> VMAsm::VMSerializer::ReadSizedData(std::ifstream& file, uint64_t &remaining) {
     uint32_t size;
-    file.read(reinterpret_cast<char*>(&size), sizeof(size));
+    ReadExact(file, &size, sizeof(size), remaining);
+
+    // 伪造的长度字段可以声称多达 4 GiB, 分配前先确认文件里确实有这么多数据
+    if (size > remaining) throw std::runtime_error("Malformed bytecode: unexpected end of file");
     std::vector<uint8_t> data(size);
-    if (size > 0) file.read(reinterpret_cast<char*>(data.data()), size);
+    if (size > 0) ReadExact(file, data.data(), size, remaining);
     return data;
 }
 
@@ -52,14 +72,17 @@ void VMAsm::VMSerializer::SerializeTables(const std::unordered_map<std::string,
     }
 }
 
-std::unordered_map<std::string, long> VMAsm::VMSerializer::DeserializeTables(std::ifstream& file, const uint32_t num_tables) {
+std::unordered_map<std::string, long> VMAsm::VMSerializer::DeserializeTables(std::ifstream& file, const uint32_t num_tables,
+                                                                            uint64_t &remaining) {
+    // 表下标的范围由 Verifier 对照指令数检查
     std::unordered_map<std::string, long> tables;
     for (uint32_t i = 0; i < num_tables; i++) {
-        auto key_data = ReadSizedData(file);
+        auto key_data = ReadSizedData(file, remaining);
+        if (key_data.empty() || key_data.back() != '\0') throw std::runtime_error("Malformed bytecode: table name");
         std::string key(reinterpret_cast<const char*>(key_data.data()));
 
         long value;
-        file.read(reinterpret_cast<char*>(&value), sizeof(value));
+        ReadExact(file, &value, sizeof(value), remaining);
 
         tables.emplace(std::move(key), value);
     }
@@ -67,7 +90,7 @@ std::unordered_map<std::string, long> VMAsm::VMSerializer::DeserializeTables(std
 }
 
 void VMAsm::VMSerializer::SerializeValue(const Value& value, std::vector<uint8_t>& buffer) {
-    buffer.push_back(value.is_reg ? 1 : 0);
+    buffer.push_back((value.is_reg ? FlagRegister : 0) | (value.is_table ? FlagTable : 0));
 
     const auto data_size = static_cast<uint32_t>(value.data.size());
     buffer.insert(buffer.end(), reinterpret_cast<const uint8_t*>(&data_size),
@@ -84,13 +107,21 @@ void VMAsm::VMSerializer::SerializeInstruction(const Instruction& instr, std::ve
     }
 }
 
-VMAsm::Value VMAsm::VMSerializer::DeserializeValue(const uint8_t*& data) {
-    Value value;
-    value.is_reg = (*data++ != 0);
+VMAsm::Value VMAsm::VMSerializer::DeserializeValue(const uint8_t*& data, const uint8_t* end) {
+    // 每个字段读取前都检查剩余长度, 截断或伪造的长度字段不会越过指令缓冲区
+    if (end - data < static_cast<std::ptrdiff_t>(1 + sizeof(uint32_t))) {
+        throw std::runtime_error("Malformed bytecode: truncated operand");
+    }
+
+    Value value{};
+    const uint8_t flags = *data++;
+    value.is_reg = (flags & FlagRegister) != 0;
+    value.is_table = (flags & FlagTable) != 0;
 
     uint32_t data_size;
     memcpy(&data_size, data, sizeof(data_size));
     data += sizeof(data_size);
+    if (static_cast<size_t>(end - data) < data_size) throw std::runtime_error("Malformed bytecode: truncated operand");
 
     value.data.assign(data, data + data_size);
     data += data_size;
@@ -99,28 +130,73 @@ VMAsm::Value VMAsm::VMSerializer::DeserializeValue(const uint8_t*& data) {
     return value;
 }
 
-VMAsm::Instruction VMAsm::VMSerializer::DeserializeInstruction(const uint8_t*& data) {
+VMAsm::Instruction VMAsm::VMSerializer::DeserializeInstruction(const uint8_t*& data, const uint8_t* end) {
+    if (end - data < 2) throw std::runtime_error("Malformed bytecode: truncated instruction");
+
     Instruction instr;
     instr.code = static_cast<OpCode>(*data++);
 
     const uint8_t num_args = *data++;
     for (uint8_t i = 0; i < num_args; i++) {
-        instr.Args.push_back(DeserializeValue(data));
+        instr.Args.push_back(DeserializeValue(data, end));
     }
 
     return instr;
 }
 
 
+void VMAsm::VMSerializer::BindReferences(std::vector<Instruction>& instructions,
+                                         const std::unordered_map<std::string, long>& tables, const char version) {
+    // 0x02 起绑定后的引用是 8 字节下标; 0x01 中的引用总是名字, 7 个字符的名字加上结尾的 '\0' 同样是 8 字节
+    const bool legacy = version < 0x02;
+    auto bind = [&](Value& value) {
+        if (value.is_reg || (!legacy && value.data.size() == sizeof(long))) return;
+        if (value.data.empty() || value.data.back() != '\0') return;
+
+        std::string name = value.to<std::string>();
+        if (!name.empty() && name[0] == '#') name = name.substr(1);
+
+        const auto it = tables.find(name);
+        if (it == tables.end()) {
+            if (value.is_table) throw std::runtime_error("Undefined table: " + name);
+            return;
+        }
+        value.is_table = true;
+        value.write(it->second);
+    };
+
+    // 当前版本的字节码中引用均已绑定为下标; 这里处理仍以名字保存的引用,
+    // 包括 0x01 版本中丢失了 is_table 标记的跳转目标
+    for (auto& [code, Args] : instructions) {
+        for (auto& arg : Args) {
+            if (arg.is_table) bind(arg);
+        }
+
+        switch (code) {
+            case OpCode::JMP:
+                if (!Args.empty()) bind(Args[0]);
+                break;
+            case OpCode::JZ:
+            case OpCode::JNZ:
+            case OpCode::JG:
+            case OpCode::JL:
+                if (Args.size() > 1) bind(Args[1]);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
 bool VMAsm::VMSerializer::SaveToFile(
-    const std::list<Instruction>& instructions,
+    const std::vector<Instruction>& instructions,
     const std::unordered_map<std::string, long>& tables,
     const std::string& filename
 ) {
     std::ofstream file(filename, std::ios::binary);
     if (!file.is_open()) return false;
 
-    constexpr char header[] = {'V', 'M', 'C', 0x01};
+    constexpr char header[] = {'V', 'M', 'C', FormatVersion};
     file.write(header, sizeof(header));
 
     const auto num_tables = static_cast<uint32_t>(tables.size());
@@ -144,29 +220,61 @@ bool VMAsm::VMSerializer::SaveToFile(VirtualMachine *vm, const std::string &file
     return SaveToFile(vm->GetInstructions(), vm->GetTables(), filename);
 }
 
+bool VMAsm::VMSerializer::SaveToFile(const Program &program, const std::string &filename) {
+    return SaveToFile(program.GetInstructions(), program.GetTables(), filename);
+}
+
 bool VMAsm::VMSerializer::LoadFromFile(VirtualMachine* vm, const std::string& filename) {
-    std::ifstream file(filename, std::ios::binary);
+    std::vector<Instruction> instructions;
+    std::unordered_map<std::string, long> tables;
+    if (!Load(filename, instructions, tables)) return false;
+
+    vm->SetTables(std::move(tables));
+    vm->SetInstructions(std::move(instructions));
+    return true;
+}
+
+std::shared_ptr<const VMAsm::Program> VMAsm::VMSerializer::LoadProgram(const std::string &filename) {
+    std::vector<Instruction> instructions;
+    std::unordered_map<std::string, long> tables;
+    if (!Load(filename, instructions, tables)) return nullptr;
+
+    return Program::Create(std::move(instructions), std::move(tables));
+}
+
+bool VMAsm::VMSerializer::Load(const std::string &filename, std::vector<Instruction> &instructions,
+                               std::unordered_map<std::string, long> &tables) {
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
     if (!file.is_open()) return false;
 
+    // 头部中的计数与长度都来自文件, 一律对照实际的文件大小检查
+    const std::streamoff file_size = file.tellg();
+    file.seekg(0, std::ios::beg);
+    if (file_size < 0 || !file) return false;
+    auto remaining = static_cast<uint64_t>(file_size);
+
     char header[4];
-    file.read(header, sizeof(header));
-    if (memcmp(header, "VMC", 3) != 0 || header[3] != 0x01) return false;
+    if (remaining < sizeof(header)) return false;
+    ReadExact(file, header, sizeof(header), remaining);
+    if (memcmp(header, "VMC", 3) != 0 || header[3] < 0x01 || header[3] > FormatVersion) return false;
 
     uint32_t num_tables;
-    file.read(reinterpret_cast<char*>(&num_tables), sizeof(num_tables));
-    auto tables = DeserializeTables(file, num_tables);
-    vm->SetTables(tables);
+    ReadExact(file, &num_tables, sizeof(num_tables), remaining);
+    tables = DeserializeTables(file, num_tables, remaining);
 
     uint32_t num_instructions;
-    file.read(reinterpret_cast<char*>(&num_instructions), sizeof(num_instructions));
+    ReadExact(file, &num_instructions, sizeof(num_instructions), remaining);
 
-    std::list<Instruction> instructions;
+    // 每条指令至少占 4 字节长度字段与 2 字节指令头, 预留的容量不超过文件能容纳的指令数
+    instructions.clear();
+    instructions.reserve(std::min<uint64_t>(num_instructions, remaining / (sizeof(uint32_t) + 2)));
     for (uint32_t i = 0; i < num_instructions; i++) {
-        auto instr_data = ReadSizedData(file);
+        auto instr_data = ReadSizedData(file, remaining);
         const uint8_t* ptr = instr_data.data();
-        instructions.push_back(DeserializeInstruction(ptr));
+        instructions.push_back(DeserializeInstruction(ptr, ptr + instr_data.size()));
     }
-    vm->SetInstructions(instructions);
 
+    BindReferences(instructions, tables, header[3]);
+    Verifier::Verify(instructions, tables);
     return true;
 }
@@ -29,16 +29,903 @@
 
 #include <iostream>
 
+#include <cstring>
 #include <filesystem>
+#include <fstream>
+#include <limits>
+#include <numeric>
+#include <sstream>
 #include "vmasm/compiler.hpp"
 #include "vmasm/disassembler.hpp"
+#include "vmasm/executor.hpp"
+#include "vmasm/optimizer.hpp"
+#include "vmasm/profiler.hpp"
 #include "vmasm/syscalls.hpp"
+#include "vmasm/trace.hpp"
+#include "vmasm/verifier.hpp"
 #include "vmasm/vm.hpp"
+#include "vmasm/vm_serializer.hpp"
 
-int main(int argc, char *argv[]) {
-    std::filesystem::path path = std::filesystem::path(".").parent_path();
+#ifndef VMASM_TEST_DIR
+#define VMASM_TEST_DIR "test"
+#endif
+
+// 条件不成立时输出说明, 返回条件本身
+static bool Expect(const bool condition, const std::string &message) {
+    if (!condition) std::cerr << "检查失败: " << message << std::endl;
+    return condition;
+}
+
+static std::string ReadSource(const std::string &name) {
+    std::ifstream file((std::filesystem::path(VMASM_TEST_DIR) / name).string());
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    return buffer.str();
+}
+
+static long RegisterLong(VMAsm::VirtualMachine &vm, const uint8_t index) {
+    return vm.GetRegisterValue(index).to<long>();
+}
+
+// 同一程序分别以 switch 与 computed-goto 分派执行, 返回状态与全部寄存器必须相同.
+// 长字符串存放在数据区, 最后一个程序没有 halt, 执行到 END 哨兵结束
+static bool CheckDispatch() {
+    const std::string sources[] = {
+        ReadSource("test.vmasm"),
+        ReadSource("jit.vmasm"),
+        "main:\n mov \"a string longer than eight bytes\", R1\n mov R1, R2\n mov [0x01, 0x02], R3\n halt\n",
+        "main:\n mov \"falls off the end\", R4\n add R5, 3, R5\n",
+    };
+
+    bool ok = true;
+    for (const std::string &source : sources) {
+        VMAsm::VirtualMachine switched;
+        VMAsm::VirtualMachine threaded;
+        for (VMAsm::VirtualMachine *vm : {&switched, &threaded}) {
+            VMAsm::SysCallRegistry::Init(vm);
+            VMAsm::Compiler().CompileString(source, vm);
+        }
+        switched.SetDispatchMode(VMAsm::DispatchMode::Switch);
+        threaded.SetDispatchMode(VMAsm::DispatchMode::Threaded);
+
+        const std::string name = source.substr(0, source.find('\n', source.find('\n') + 1));
+        ok = Expect(switched.Execute() == threaded.Execute(), "两种分派方式的返回状态不同: " + name) && ok;
+        for (uint8_t i = 0; i < VMAsm::RegisterCount; ++i) {
+            ok = Expect(switched.GetRegisterValue(i).data == threaded.GetRegisterValue(i).data,
+                        "R" + std::to_string(i) + " 在两种分派方式下不同: " + name) && ok;
+        }
+    }
+
+    VMAsm::VirtualMachine ended;
+    VMAsm::Compiler().CompileString(sources[3], &ended);
+    ended.SetDispatchMode(VMAsm::DispatchMode::Threaded);
+    ended.Execute();
+    ok = Expect(ended.GetRegisterValue(4).to<std::string>() == "falls off the end" && RegisterLong(ended, 5) == 3,
+                "执行到末尾的程序") && ok;
+    return ok;
+}
+
+static void WriteBytes(const std::string &path, const std::vector<char> &bytes) {
+    std::ofstream file(path, std::ios::binary);
+    file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+}
+
+// 手工构造的 0x01 版本字节码: 跳转目标以名字保存, 且没有 is_table 标记.
+// 7 个字符的名字加上结尾的 '\0' 与整数下标同为 8 字节, 仍要按名字绑定
+static bool CheckLegacyBytecode() {
+    auto append = [](std::vector<char> &out, const void *data, const size_t size) {
+        out.insert(out.end(), static_cast<const char *>(data), static_cast<const char *>(data) + size);
+    };
+    auto sized = [&append](std::vector<char> &out, const void *data, const uint32_t size) {
+        append(out, &size, sizeof(size));
+        append(out, data, size);
+    };
+    // 操作数: 标志字节 (0x01 版本中只有 is_reg), 长度, 数据
+    auto operand = [&sized](const uint8_t flags, const void *data, const uint32_t size) {
+        std::vector<char> out = {static_cast<char>(flags)};
+        sized(out, data, size);
+        return out;
+    };
+    const uint8_t r1 = 1;
+    const long three = 3;
+    const long one = 1;
+    const std::vector<char> reg = operand(1, &r1, sizeof(r1));
+
+    std::vector<char> bytes = {'V', 'M', 'C', 0x01};
+    const uint32_t num_tables = 2;
+    append(bytes, &num_tables, sizeof(num_tables));
+    for (const auto &[name, index] : {std::pair<std::string, long>{"main", 0}, {"looping", 1}}) {
+        sized(bytes, name.c_str(), static_cast<uint32_t>(name.size() + 1));
+        append(bytes, &index, sizeof(index));
+    }
+
+    const std::pair<VMAsm::OpCode, std::vector<std::vector<char>>> instructions[] = {
+        {VMAsm::OpCode::MOV, {operand(0, &three, sizeof(three)), reg}},
+        {VMAsm::OpCode::SUB, {reg, operand(0, &one, sizeof(one)), reg}},
+        {VMAsm::OpCode::JNZ, {reg, operand(0, "looping", 8)}},
+        {VMAsm::OpCode::HALT, {}},
+    };
+    const auto num_instructions = static_cast<uint32_t>(std::size(instructions));
+    append(bytes, &num_instructions, sizeof(num_instructions));
+    for (const auto &[code, operands] : instructions) {
+        std::vector<char> record = {static_cast<char>(code), static_cast<char>(operands.size())};
+        for (const auto &data : operands) record.insert(record.end(), data.begin(), data.end());
+        sized(bytes, record.data(), static_cast<uint32_t>(record.size()));
+    }
+
+    const std::string path = (std::filesystem::temp_directory_path() / "vmasm_legacy.vmc").string();
+    WriteBytes(path, bytes);
+    VMAsm::VirtualMachine vm;
+    bool ok = Expect(VMAsm::VMSerializer::LoadFromFile(&vm, path), "0x01 版本的字节码可以加载");
+    std::filesystem::remove(path);
+    if (!ok) return false;
+
+    const VMAsm::Value &target = vm.GetInstructions()[2].Args[1];
+    ok = Expect(target.is_table && target.to<long>() == 1, "7 个字符的标签绑定为下标") && ok;
+    vm.Execute();
+    ok = Expect(RegisterLong(vm, 1) == 0, "按绑定后的目标循环") && ok;
+    return ok;
+}
+
+// 每种超级指令至少出现一次, 融合与不融合的结果必须相同.
+// mov 100, R9 与 mov 7, R3 组成 mov+mov, 从 second 进入时只执行组内第二条
+static bool CheckFusion() {
+    const std::string source = "main:\n mov 3, R1\n jmp #second\nfirst:\n mov 100, R9\nsecond:\n mov 7, R3\n"
+                               "loop:\n add R2, R1, R2\n sub R1, 1, R1\n jnz R1, #loop\n"
+                               " mov 10, R4\n add R4, R3, R5\n add R5, 1, R6\n sub R6, 18, R10\n jz R10, #equal\n halt\n"
+                               "equal:\n mov 2, R7\ncount:\n sub R7, 1, R7\n jg R7, #count\n halt\n";
+
+    VMAsm::VirtualMachine plain;
+    plain.SetFusionEnabled(false);
+    VMAsm::Compiler().CompileString(source, &plain);
+    const int expected = plain.Execute();
+    bool ok = Expect(plain.GetFusionStats().empty(), "关闭融合时没有超级指令");
+
+    for (const VMAsm::DispatchMode mode : {VMAsm::DispatchMode::Switch, VMAsm::DispatchMode::Threaded}) {
+        VMAsm::VirtualMachine fused;
+        fused.SetFusionEnabled(true);
+        fused.SetDispatchMode(mode);
+        VMAsm::Compiler().CompileString(source, &fused);
+        ok = Expect(fused.Execute() == expected, "融合后的返回状态") && ok;
+        for (uint8_t i = 0; i < VMAsm::RegisterCount; ++i) {
+            ok = Expect(fused.GetRegisterValue(i).data == plain.GetRegisterValue(i).data,
+                        "R" + std::to_string(i) + " 在融合后不同") && ok;
+        }
+
+        for (const char *pattern : {"mov+mov", "mov+add", "add+add", "sub+jz", "sub+jnz", "sub+jg", "add+sub+jnz"}) {
+            bool found = false;
+            for (const auto &stat : fused.GetFusionStats()) found = found || (stat.pattern == pattern && stat.sites > 0);
+            ok = Expect(found, std::string("没有融合 ") + pattern) && ok;
+        }
+    }
+
+    ok = Expect(plain.GetRegisterValue(9).data.empty() && RegisterLong(plain, 3) == 7 && RegisterLong(plain, 2) == 6 &&
+                RegisterLong(plain, 10) == 0 && RegisterLong(plain, 7) == 0, "超级指令程序的结果") && ok;
+    return ok;
+}
+
+// 分别以解释器与 JIT 执行同一程序, 比较返回状态与全部寄存器
+static bool CheckJit(const std::string &file) {
+    VMAsm::VirtualMachine interpreted;
+    VMAsm::VirtualMachine compiled;
+    VMAsm::SysCallRegistry::Init(&interpreted);
+    VMAsm::SysCallRegistry::Init(&compiled);
+
+    if (!VMAsm::Compiler().Compile({file}, &interpreted) || !VMAsm::Compiler().Compile({file}, &compiled)) {
+        std::cerr << "编译失败: " << file << std::endl;
+        return false;
+    }
+    if (!compiled.SetJitEnabled(true)) {
+        std::cout << "当前平台不支持 JIT, 跳过: " << file << std::endl;
+        return true;
+    }
+    compiled.SetJitThreshold(1);
+
+    const int expected = interpreted.Execute();
+    const int actual = compiled.Execute();
+    bool ok = expected == actual;
+    for (uint8_t i = 0; i < VMAsm::RegisterCount; ++i) {
+        if (interpreted.GetRegisterValue(i).data != compiled.GetRegisterValue(i).data) {
+            std::cerr << "R" << static_cast<int>(i) << " 不一致: " << file << std::endl;
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+static bool CheckSnapshots() {
+    // snap_pop 恢复 snap_push 时的全部寄存器, 之后的写入不影响已保存的状态
+    VMAsm::VirtualMachine popped;
+    VMAsm::Compiler().CompileString("main:\n mov 1, R1\n snap_push\n mov 2, R1\n mov 5, R5\n snap_pop\n mov 1, R2\n",
+                                    &popped);
+    bool ok = Expect(popped.Execute() == VMAsm::StatusEnd && popped.GetInstructionCount() == 6 &&
+                     popped.GetSnapshotDepth() == 0, "snap_pop 的状态与指令数");
+    ok = Expect(RegisterLong(popped, 1) == 1 && RegisterLong(popped, 2) == 1 && popped.GetRegisterValue(5).data.empty(),
+                "snap_pop 恢复寄存器") && ok;
+
+    // 嵌套的快照由宿主逐层弹出, 栈底不能弹出
+    VMAsm::VirtualMachine nested;
+    VMAsm::Compiler().CompileString("main:\n mov 1, R1\n snap_push\n mov 2, R1\n snap_push\n mov 3, R1\n halt\n", &nested);
+    ok = Expect(nested.Execute() == VMAsm::StatusHalt && nested.GetInstructionCount() == 6 &&
+                nested.GetSnapshotDepth() == 2 && RegisterLong(nested, 1) == 3, "嵌套 snap_push") && ok;
+    ok = Expect(nested.PopSnapshot() && RegisterLong(nested, 1) == 2, "弹出第二层快照") && ok;
+    ok = Expect(nested.PopSnapshot() && RegisterLong(nested, 1) == 1, "弹出第一层快照") && ok;
+    ok = Expect(!nested.PopSnapshot() && nested.GetSnapshotDepth() == 0, "栈底快照不能弹出") && ok;
+
+    // snap_swap 交换当前寄存器与 snap_save 保存的快照
+    VMAsm::VirtualMachine swapped;
+    VMAsm::Compiler().CompileString("main:\n mov 1, R1\n snap_save\n mov 2, R1\n snap_swap\n halt\n", &swapped);
+    ok = Expect(swapped.Execute() == VMAsm::StatusHalt && swapped.GetInstructionCount() == 5 &&
+                RegisterLong(swapped, 1) == 1, "snap_swap 换回保存的寄存器") && ok;
+    swapped.SwapSnapshot();
+    ok = Expect(RegisterLong(swapped, 1) == 2, "再次交换得到修改后的寄存器") && ok;
+    return ok;
+}
+
+// 同一份 Program 挂载到多个虚拟机, 寄存器与执行状态互不影响, 映像本身不被修改
+static bool CheckSharedProgram() {
+    const auto program = VMAsm::Compiler().CompileString("main:\n add R1, 1, R1\n mov \"a shared program image\", R2\n"
+                                                         " halt\n");
+    const size_t tables = program->GetTables().size();
+
+    VMAsm::VirtualMachine first;
+    VMAsm::VirtualMachine second;
+    first.Attach(program);
+    second.Attach(program);
+    VMAsm::Value ten;
+    ten.write(10L);
+    first.SetRegisterValue(1, ten);
+
+    first.Execute();
+    second.Execute();
+    second.Execute();
+    bool ok = Expect(RegisterLong(first, 1) == 11 && RegisterLong(second, 1) == 2, "各自的寄存器");
+    ok = Expect(first.GetRegisterValue(2).to<std::string>() == "a shared program image" &&
+                second.GetRegisterValue(2).to<std::string>() == "a shared program image", "各自的字符串寄存器") && ok;
+    ok = Expect(first.GetProgram() == program && second.GetProgram() == program, "挂载时不复制映像") && ok;
+
+    // 查找不存在的表只读, 不会插入; 虚拟机从不存在的入口执行时从 0 开始
+    ok = Expect(program->FindTable("missing") == -1 && program->GetTables().size() == tables, "FindTable 不插入") && ok;
+    first.Execute("missing");
+    ok = Expect(RegisterLong(first, 1) == 12 && program->GetTables().size() == tables, "从不存在的入口执行") && ok;
+    return ok;
+}
+
+static bool CheckExecutor() {
+    const auto program = VMAsm::Compiler().CompileString("main:\n mov 0, R2\nloop:\n add R2, R1, R2\n sub R1, 1, R1\n"
+                                                         " jnz R1, #loop\n halt\nbad:\n sys 99\n");
+    std::vector<VMAsm::Job> jobs;
+    for (long n = 1; n <= 20; ++n) {
+        VMAsm::Job job;
+        job.program = program;
+        VMAsm::Value count;
+        count.write(n);
+        job.registers.emplace_back(1, count);
+        jobs.push_back(std::move(job));
+    }
+    VMAsm::Job bad;
+    bad.program = program;
+    bad.entry = "bad";
+    jobs.push_back(bad);
+    jobs.emplace_back();
+
+    // 结果与任务一一对应; 出错的任务只影响自己
+    VMAsm::Executor executor(4);
+    const auto results = executor.Run(jobs);
+    bool ok = Expect(results.size() == jobs.size() && executor.GetStats().jobs == jobs.size(), "结果数量");
+    for (long n = 1; n <= 20 && ok; ++n) {
+        const auto &result = results[n - 1];
+        ok = Expect(!result.failed && result.status == VMAsm::StatusHalt &&
+                    result.instructions == static_cast<uint64_t>(3 * n + 2) &&
+                    result.registers[2].to<long>() == n * (n + 1) / 2, "任务 " + std::to_string(n) + " 的结果") && ok;
+    }
+    ok = Expect(results[20].failed && !results[20].error.empty(), "未注册的系统调用使任务失败") && ok;
+    ok = Expect(results[21].failed && results[21].error == "Job has no program", "没有程序的任务失败") && ok;
+
+    // 准备虚拟机时抛出的任何异常都记录在结果中, 不会终止工作线程
+    VMAsm::Executor throwing(2);
+    throwing.SetSetup([](VMAsm::VirtualMachine &) { throw 1; });
+    for (const auto &result : throwing.Run({jobs[0], jobs[1]})) {
+        ok = Expect(result.failed && result.error == "Unknown exception", "准备时抛出的异常") && ok;
+    }
+    return ok;
+}
+
+static bool CheckBudgets() {
+    const std::string loop = "main:\n mov 1000, R1\nloop:\n sub R1, 1, R1\n jnz R1, #loop\n halt\n";
+    VMAsm::VirtualMachine whole;
+    VMAsm::Compiler().CompileString(loop, &whole);
+    bool ok = Expect(whole.Execute() == VMAsm::StatusHalt && whole.GetInstructionCount() == 2002, "不限预算的执行");
+
+    // 预算只在跳转处检查: 执行满 100 条后停在下一次回边, 寄存器与 PC 保持不变
+    VMAsm::VirtualMachine budgeted;
+    VMAsm::Compiler().CompileString(loop, &budgeted);
+    ok = Expect(budgeted.Execute("main", 100) == VMAsm::StatusYielded && budgeted.IsYielded() &&
+                budgeted.GetInstructionCount() == 101 && budgeted.GetProgramCounter() == 1 &&
+                RegisterLong(budgeted, 1) == 950, "预算耗尽时暂停") && ok;
+
+    int status;
+    size_t slices = 1;
+    uint64_t previous = budgeted.GetInstructionCount();
+    while ((status = budgeted.Resume(100)) == VMAsm::StatusYielded) {
+        ok = Expect(budgeted.GetInstructionCount() >= previous + 100, "每次恢复至少执行预算条指令") && ok;
+        previous = budgeted.GetInstructionCount();
+        if (++slices > 100) break;
+    }
+    ok = Expect(status == VMAsm::StatusHalt && budgeted.GetInstructionCount() == whole.GetInstructionCount() &&
+                RegisterLong(budgeted, 1) == 0, "分段执行与一次执行的结果相同") && ok;
+
+    // 执行到末尾返回 StatusEnd; 没有暂停时不能恢复
+    VMAsm::VirtualMachine ended;
+    VMAsm::Compiler().CompileString("main:\n mov 1, R1\n mov 2, R2\n", &ended);
+    ok = Expect(ended.Execute("main", 100) == VMAsm::StatusEnd && ended.GetInstructionCount() == 2, "执行到末尾") && ok;
+    try {
+        ended.Resume();
+        ok = Expect(false, "结束后仍可以恢复") && ok;
+    } catch (const std::runtime_error &) {
+    }
+    return ok;
+}
+
+static bool CheckSuspend() {
+    // 系统调用挂起虚拟机, 宿主写入结果后从下一条指令继续
+    VMAsm::VirtualMachine vm;
+    long request = 0;
+    vm.RegisterSyscall(200, [&request](VMAsm::VirtualMachine *machine, const VMAsm::SyscallArgs &args) {
+        request = args.GetLong(0);
+        machine->Suspend();
+    });
+    VMAsm::Compiler().CompileString("main:\n mov 1, R1\n sys 200, R1\n add R0, R1, R2\n halt\n", &vm);
+
+    bool ok = Expect(vm.Execute() == VMAsm::StatusSuspended && vm.IsSuspended() && request == 1 &&
+                     vm.GetInstructionCount() == 2 && vm.GetProgramCounter() == 2, "系统调用挂起");
+    vm.SetRegisterValue(0, 41L);
+    ok = Expect(vm.Resume() == VMAsm::StatusHalt && !vm.IsSuspended() && vm.GetInstructionCount() == 4 &&
+                RegisterLong(vm, 2) == 42, "写入结果后恢复") && ok;
+    return ok;
+}
+
+static long AddPair(const long a, const long b) {
+    return a + b;
+}
+
+// 类型化系统调用的参数个数在第一次执行前核对, 不匹配时一条指令也不执行
+static bool CheckSyscallArity() {
+    VMAsm::VirtualMachine good;
+    good.RegisterSyscall<&AddPair>(100);
+    VMAsm::Compiler().CompileString("main:\n mov 2, R1\n sys 100, R1, 40\n halt\n", &good);
+    bool ok = Expect(good.Execute() == VMAsm::StatusHalt && RegisterLong(good, 0) == 42, "参数个数正确的调用");
+
+    VMAsm::VirtualMachine bad;
+    bad.RegisterSyscall<&AddPair>(100);
+    VMAsm::Compiler().CompileString("main:\n mov 2, R1\n sys 100, R1\n halt\n", &bad);
+    try {
+        bad.Execute();
+        ok = Expect(false, "参数个数错误的调用被接受") && ok;
+    } catch (const std::runtime_error &e) {
+        ok = Expect(std::string(e.what()).find("expects 2 argument(s), got 1") != std::string::npos,
+                    std::string("参数个数错误的信息: ") + e.what()) && ok;
+        ok = Expect(bad.GetInstructionCount() == 0 && bad.GetRegisterValue(1).data.empty(), "核对在执行之前") && ok;
+    }
+    return ok;
+}
+
+// 输出先写入虚拟机的缓冲区, 写满、结束执行或抛出异常时交给输出函数
+static bool CheckOutput() {
+    std::vector<std::string> chunks;
+    auto capture = [&chunks](const std::string_view text) { chunks.emplace_back(text); };
+    auto joined = [&chunks] {
+        std::string text;
+        for (const std::string &chunk : chunks) text += chunk;
+        return text;
+    };
+
+    VMAsm::VirtualMachine buffered;
+    VMAsm::SysCallRegistry::Init(&buffered);
+    buffered.SetOutput(capture, 16);
+    VMAsm::Compiler().CompileString("main:\n mov 5, R1\nloop:\n sys 1, \"line %d\\n\", R1\n sub R1, 1, R1\n"
+                                    " jnz R1, #loop\n halt\n", &buffered);
+    bool ok = Expect(buffered.Execute() == VMAsm::StatusHalt && joined() == "line 5\nline 4\nline 3\nline 2\nline 1\n",
+                     "缓冲输出的内容");
+    ok = Expect(chunks.size() > 1, "缓冲区写满时输出") && ok;
+    for (size_t i = 0; i + 1 < chunks.size(); ++i) ok = Expect(chunks[i].size() >= 16, "未写满就输出") && ok;
+
+    // 常量格式串在加载时解析, 结果与运行时从寄存器读取格式串相同
+    const std::string constant = "main:\n mov \"name\", R2\n mov -12, R1\n sys 1, \"%s=%d %x|%%\\n\", R2, R1, R1\n halt\n";
+    const std::string runtime = "main:\n mov \"name\", R2\n mov -12, R1\n mov \"%s=%d %x|%%\\n\", R3\n"
+                                " sys 1, R3, R2, R1, R1\n halt\n";
+    std::string printed[2];
+    size_t formats[2];
+    for (int i = 0; i < 2; ++i) {
+        chunks.clear();
+        VMAsm::VirtualMachine vm;
+        VMAsm::SysCallRegistry::Init(&vm);
+        vm.SetOutput(capture);
+        VMAsm::Compiler().CompileString(i == 0 ? constant : runtime, &vm);
+        vm.Execute();
+        printed[i] = joined();
+        formats[i] = vm.GetProgram()->GetFormats().size();
+    }
+    ok = Expect(formats[0] == 1 && formats[1] == 0, "只有常量格式串预先解析") && ok;
+    ok = Expect(!printed[0].empty() && printed[0] == printed[1], "预解析与运行时格式化的结果: " + printed[0]) && ok;
+
+    // halt、执行到末尾与异常都会写出缓冲区中的内容
+    const std::pair<const char *, const char *> endings[] = {
+        {"halt", "main:\n sys 1, \"halt\"\n halt\n"},
+        {"end", "main:\n sys 1, \"end\"\n"},
+        {"throw", "main:\n sys 1, \"throw\"\n sys 99\n"},
+    };
+    for (const auto &[text, source] : endings) {
+        chunks.clear();
+        VMAsm::VirtualMachine vm;
+        VMAsm::SysCallRegistry::Init(&vm);
+        vm.SetOutput(capture);
+        VMAsm::Compiler().CompileString(source, &vm);
+        try {
+            vm.Execute();
+        } catch (const std::runtime_error &) {
+        }
+        ok = Expect(joined() == text, std::string("结束方式 ") + text + " 没有写出输出") && ok;
+    }
+    return ok;
+}
+
+// 按指令下标与按指令类型的计数之和都等于执行的指令数
+static bool CheckProfile() {
+    VMAsm::VirtualMachine vm;
+    VMAsm::Compiler().CompileString("main:\n mov 1000, R1\nloop:\n sub R1, 1, R1\n jnz R1, #loop\n halt\n", &vm);
+    if (!vm.SetProfilingEnabled(true)) {
+        std::cout << "未启用 VMASM_PROFILE, 跳过剖析检查" << std::endl;
+        return true;
+    }
+
+    bool ok = Expect(vm.Execute() == VMAsm::StatusHalt, "剖析时的执行结果");
+    const VMAsm::Profile *profile = vm.GetProfile();
+    const uint64_t per_pc = std::accumulate(profile->instructions.begin(), profile->instructions.end(), uint64_t{0});
+    const uint64_t per_opcode = std::accumulate(profile->opcodes.begin(), profile->opcodes.end(), uint64_t{0});
+    ok = Expect(per_pc == vm.GetInstructionCount() && per_opcode == per_pc && profile->GetTotal() == per_pc,
+                "计数之和等于指令数") && ok;
+    ok = Expect(profile->instructions == std::vector<uint64_t>{1, 1000, 1000, 1}, "各指令的执行次数") && ok;
+    return ok;
+}
+
+// 折叠栈的每一行以执行时给出的入口为根, 样本数之和等于总样本数
+static bool CheckSampling() {
+    VMAsm::VirtualMachine vm;
+    VMAsm::Compiler().CompileString("#table work\nmain:\n halt\nwork:\n mov 1000, R1\nloop:\n sub R1, 1, R1\n"
+                                    " jnz R1, #loop\n halt\n", &vm);
+    VMAsm::SamplingProfiler profiler(10);
+    bool ok = Expect(profiler.Execute(vm, "work") == VMAsm::StatusHalt && RegisterLong(vm, 1) == 0 &&
+                     profiler.GetSampleCount() > 0, "采样时的执行结果");
+
+    std::istringstream lines(profiler.Collapse());
+    std::string line;
+    uint64_t total = 0;
+    bool loop = false;
+    while (std::getline(lines, line)) {
+        const size_t space = line.rfind(' ');
+        const std::string stack = line.substr(0, space);
+        ok = Expect(space != std::string::npos && (stack == "work" || stack.rfind("work;", 0) == 0),
+                    "折叠栈没有以入口为根: " + line) && ok;
+        total += std::stoull(line.substr(space + 1));
+        loop = loop || stack == "work;loop";
+    }
+    ok = Expect(loop && total == profiler.GetSampleCount(), "折叠栈的样本数") && ok;
+    return ok;
+}
+
+// 环形缓冲区只保留最近的记录; 写出的 VMTR 文件读回后与缓冲区一致
+static bool CheckTrace() {
+    VMAsm::VirtualMachine vm;
+    VMAsm::Compiler().CompileString("main:\n mov 1000, R1\nloop:\n sub R1, 1, R1\n jnz R1, #loop\n halt\n", &vm);
+    vm.StartTrace(8);
+    bool ok = Expect(vm.Execute() == VMAsm::StatusHalt, "跟踪时的执行结果");
+    vm.StopTrace();
+
+    const VMAsm::TraceBuffer *trace = vm.GetTrace();
+    ok = Expect(trace->GetCapacity() == 8 && trace->Size() == 8 && trace->GetWritten() == vm.GetInstructionCount(),
+                "跟踪记录数") && ok;
+    const std::vector<VMAsm::TraceRecord> records = trace->GetRecords();
+    std::vector<uint32_t> pcs;
+    for (const VMAsm::TraceRecord &record : records) pcs.push_back(record.pc);
+    ok = Expect(pcs == std::vector<uint32_t>{2, 1, 2, 1, 2, 1, 2, 3}, "保留最后 8 条记录") && ok;
+    ok = Expect(records[6].code == VMAsm::OpCode::JNZ && records[7].code == VMAsm::OpCode::HALT &&
+                records[5].reg == 1 && records[5].value == 0, "记录的指令与寄存器") && ok;
+
+    const std::string path = (std::filesystem::temp_directory_path() / "vmasm_test.vmtr").string();
+    VMAsm::TraceFile file;
+    ok = Expect(vm.DumpTrace(path) && VMAsm::TraceFile::Load(path, file), "写出并读回跟踪文件") && ok;
+    ok = Expect(file.instructions == 4 && file.written == trace->GetWritten() && file.records.size() == records.size() &&
+                std::memcmp(file.records.data(), records.data(), records.size() * sizeof(VMAsm::TraceRecord)) == 0,
+                "读回的记录与缓冲区一致") && ok;
+
+    const std::string listing = VMAsm::Disassembler().DisassembleTrace(path, &vm);
+    ok = Expect(listing.find(std::to_string(trace->GetWritten() - 8) + " earlier record(s) overwritten") !=
+                std::string::npos && listing.find("halt") != std::string::npos, "跟踪的反汇编") && ok;
+    std::filesystem::remove(path);
+    return ok;
+}
+
+// 编译时应抛出 std::runtime_error, 且信息中包含 needle
+static bool ExpectCompileError(VMAsm::Compiler &compiler, const std::string &source, const std::string &needle) {
+    try {
+        compiler.CompileString(source);
+    } catch (const std::runtime_error &e) {
+        return Expect(std::string(e.what()).find(needle) != std::string::npos,
+                      "错误信息 \"" + std::string(e.what()) + "\" 中没有 " + needle);
+    }
+    return Expect(false, "应当编译失败: " + needle);
+}
+
+// 校验应抛出 std::runtime_error, 且信息中包含 needle
+static bool ExpectRejected(const std::vector<VMAsm::Instruction> &instructions,
+                           const std::unordered_map<std::string, long> &tables, const std::string &needle) {
+    try {
+        VMAsm::Verifier::Verify(instructions, tables);
+    } catch (const std::runtime_error &e) {
+        return Expect(std::string(e.what()).find(needle) != std::string::npos,
+                      "错误信息 \"" + std::string(e.what()) + "\" 中没有 " + needle);
+    }
+    return Expect(false, "应当校验失败: " + needle);
+}
+
+static bool CheckVerifier() {
+    using VMAsm::OpCode;
+    VMAsm::Value reg;
+    reg.is_reg = true;
+    reg.write(static_cast<uint8_t>(64));
+    VMAsm::Value target;
+    target.is_table = true;
+    target.write(2L);
+    VMAsm::Value one;
+    one.write(1L);
+
+    VMAsm::Compiler compiler;
+    bool ok = ExpectCompileError(compiler, "main:\n mov 1\n", "expects 2 operand(s), got 1");
+    ok = ExpectCompileError(compiler, "main:\n halt R1\n", "expects 0 operand(s), got 1") && ok;
+    ok = ExpectRejected({{OpCode::MOV, {one, reg}}}, {}, "register index out of range") && ok;
+    // 跳转目标可以等于程序长度 (结束哨兵), 再往后就越界
+    ok = ExpectRejected({{OpCode::JMP, {target}}}, {}, "jump target out of range") && ok;
+    ok = ExpectRejected({{OpCode::HALT, {}}}, {{"main", 2}}, "points outside the program") && ok;
+    ok = ExpectCompileError(compiler, "main:\n sys 0\n", "syscall ID out of range") && ok;
+    ok = ExpectCompileError(compiler, "main:\n sys 256\n", "syscall ID out of range") && ok;
+    ok = ExpectCompileError(compiler, "main:\n sys R1\n", "call ID must be a constant") && ok;
+    try {
+        VMAsm::Verifier::Verify({{OpCode::JMP, {target}}, {OpCode::HALT, {}}}, {{"main", 2}});
+    } catch (const std::exception &e) {
+        ok = Expect(false, std::string("合法程序被拒绝: ") + e.what()) && ok;
+    }
+    return ok;
+}
+
+// 损坏的字节码只能以 std::runtime_error 报告, 不能崩溃或抛出其他异常
+static bool ExpectLoadError(const std::string &path, const std::string &what) {
+    bool ok = true;
+    try {
+        VMAsm::VirtualMachine vm;
+        VMAsm::VMSerializer::LoadFromFile(&vm, path);
+        ok = Expect(false, "LoadFromFile 接受了" + what);
+    } catch (const std::runtime_error &) {
+    } catch (const std::exception &e) {
+        ok = Expect(false, "LoadFromFile 读取" + what + "时抛出 " + e.what());
+    }
+    try {
+        VMAsm::VMSerializer::LoadProgram(path);
+        ok = Expect(false, "LoadProgram 接受了" + what) && ok;
+    } catch (const std::runtime_error &) {
+    } catch (const std::exception &e) {
+        ok = Expect(false, "LoadProgram 读取" + what + "时抛出 " + e.what()) && ok;
+    }
+    return ok;
+}
+
+static bool CheckBytecodeLoading() {
+    const std::string path = (std::filesystem::temp_directory_path() / "vmasm_test.vmc").string();
+    const auto program = VMAsm::Compiler().CompileString("main:\n mov 3, R1\nloop:\n sub R1, 1, R1\n"
+                                                         " jnz R1, #loop\n mov \"done\", R2\n halt\n");
+    VMAsm::VMSerializer::SaveToFile(*program, path);
+
+    std::vector<char> bytes;
+    {
+        std::ifstream file(path, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    const auto loaded = VMAsm::VMSerializer::LoadProgram(path);
+    bool ok = Expect(loaded && loaded->Size() == program->Size(), "完整的字节码可以加载");
 
-    std::cout << path;
+    // 任意位置截断: 不足文件头时不是字节码, 其余都是格式错误
+    for (size_t length = 0; length < bytes.size(); ++length) {
+        WriteBytes(path, {bytes.begin(), bytes.begin() + static_cast<long>(length)});
+        if (length < 4) {
+            VMAsm::VirtualMachine vm;
+            ok = Expect(!VMAsm::VMSerializer::LoadFromFile(&vm, path) && !VMAsm::VMSerializer::LoadProgram(path),
+                        "截断在文件头中的文件不是字节码") && ok;
+        } else {
+            ok = ExpectLoadError(path, "截断为 " + std::to_string(length) + " 字节的文件") && ok;
+        }
+    }
+
+    // 伪造的计数与长度字段
+    auto forged = [](const std::vector<uint32_t> &words) {
+        std::vector<char> data = {'V', 'M', 'C', 0x02};
+        for (const uint32_t word : words) {
+            for (int i = 0; i < 4; ++i) data.push_back(static_cast<char>(word >> (8 * i) & 0xff));
+        }
+        return data;
+    };
+    WriteBytes(path, forged({0, 0xffffffffu}));
+    ok = ExpectLoadError(path, "伪造的指令数") && ok;
+    WriteBytes(path, forged({0, 1, 0x7fffffffu}));
+    ok = ExpectLoadError(path, "伪造的指令长度") && ok;
+    WriteBytes(path, forged({0xffffffffu, 0xfffffff0u}));
+    ok = ExpectLoadError(path, "伪造的表名长度") && ok;
+
+    std::filesystem::remove(path);
+    return ok;
+}
+
+// 按指定优化级别编译并执行一次的结果
+struct RunResult {
+    int status{};
+    uint64_t instructions{};
+    std::vector<std::vector<uint8_t>> registers{};
+    VMAsm::OptimizerStats stats{};
+    long size{};
+};
+
+static RunResult RunAt(const std::string &source, const int level, const std::string &entry = "main") {
+    VMAsm::Compiler compiler;
+    compiler.SetOptimizationLevel(level);
+    const auto program = compiler.CompileString(source);
+
+    VMAsm::VirtualMachine vm;
+    VMAsm::SysCallRegistry::Init(&vm);
+    vm.SetOutput([](std::string_view) {});
+    vm.Attach(program);
+
+    RunResult result;
+    result.status = vm.Execute(entry);
+    result.instructions = vm.GetInstructionCount();
+    for (uint8_t i = 0; i < VMAsm::RegisterCount; ++i) result.registers.push_back(vm.GetRegisterValue(i).data);
+    result.stats = compiler.GetOptimizerStats();
+    result.size = program->Size();
+    return result;
+}
+
+// 优化不能改变程序的结果: 各级别的返回状态与全部寄存器必须与 -O0 相同
+static bool CheckLevels(const std::string &name, const std::string &source, const std::string &entry = "main") {
+    const RunResult expected = RunAt(source, VMAsm::OptimizeNone, entry);
+    bool ok = true;
+    for (const int level : {VMAsm::OptimizeConstants, VMAsm::OptimizeDeadCode}) {
+        const RunResult actual = RunAt(source, level, entry);
+        ok = Expect(actual.status == expected.status && actual.registers == expected.registers,
+                    name + " 在 -O" + std::to_string(level) + " 下结果与 -O0 不同") && ok;
+    }
+    return ok;
+}
+
+static long RegisterLong(const RunResult &result, const size_t index) {
+    VMAsm::Value value;
+    value.data = result.registers[index];
+    return value.to<long>();
+}
+
+static bool CheckConstantFolding() {
+    bool ok = CheckLevels("test.vmasm", ReadSource("test.vmasm")) && CheckLevels("jit.vmasm", ReadSource("jit.vmasm"));
+
+    const std::string chain = "main:\n mov 6, R1\n add R1, 4, R2\n sub R2, R1, R3\n neg R3, R4\n"
+                              " jz R4, #skip\n mov 1, R5\nskip:\n halt\n";
+    ok = CheckLevels("常量链", chain) && ok;
+    const RunResult folded = RunAt(chain, VMAsm::OptimizeConstants);
+    ok = Expect(folded.stats.folded == 3 && folded.stats.propagated == 5 && folded.stats.branches == 1,
+                "常量链的折叠计数") && ok;
+    ok = Expect(RegisterLong(folded, 4) == -4 && RegisterLong(folded, 5) == 1, "常量链的结果") && ok;
+
+    // 按无符号回绕折叠, 与运行时一致
+    ok = CheckLevels("溢出回绕", "main:\n mov 9223372036854775807, R1\n add R1, 1, R2\n sub R2, 1, R3\n halt\n") && ok;
+
+    // x + 0 只在 x 已知为整数时化简; 字符串与空寄存器经过加法后变为整数
+    const std::string identities = "main:\n add R5, R6, R1\n add R1, 0, R1\n sub R1, 0, R2\n add 0, R2, R3\n"
+                                   " mov \"text\", R4\n add R4, 0, R4\n sub R7, 0, R7\n halt\n";
+    ok = CheckLevels("恒等运算", identities) && ok;
+    const RunResult identity = RunAt(identities, VMAsm::OptimizeConstants);
+    ok = Expect(identity.stats.folded == 3 && identity.size == 7, "恒等运算的化简计数") && ok;
+    return ok;
+}
+
+static bool CheckDeadCode() {
+    const std::string dead = "main:\n mov 1, R1\n mov 2, R1\n mov 3, R2\n jmp #end\n mov 4, R3\n mov 5, R4\n"
+                             "end:\n halt\n";
+    bool ok = CheckLevels("死存储与不可达代码", dead);
+    const RunResult removed = RunAt(dead, VMAsm::OptimizeDeadCode);
+    ok = Expect(removed.stats.dead_stores == 1 && removed.stats.unreachable == 2 && removed.stats.fallthrough == 1 &&
+                removed.stats.removed == 4 && removed.size == 3, "死存储与不可达代码的计数") && ok;
+
+    // 普通标签只是跳转目标, 不是入口: 只能经由标签到达的代码块同样删除
+    const RunResult labeled = RunAt("main:\n mov 1, R1\n halt\nunused:\n mov 2, R2\n halt\n", VMAsm::OptimizeDeadCode);
+    ok = Expect(labeled.stats.unreachable == 2 && labeled.size == 2 && labeled.registers[2].empty(),
+                "删除带标签的死代码块") && ok;
+
+    // 删除指令后标签与表仍指向原来的指令, 从任一入口执行的结果不变
+    const std::string entries = "#table entry\nmain:\n mov 1, R1\n mov 1, R1\n jmp #done\n mov 9, R9\n"
+                                "entry:\n mov 7, R7\n jmp #done\n mov 8, R8\ndone:\n halt\n";
+    for (const char *entry : {"main", "entry", "done"}) {
+        ok = CheckLevels(std::string("从 ") + entry + " 进入", entries, entry) && ok;
+    }
+    VMAsm::Compiler compiler;
+    compiler.SetOptimizationLevel(VMAsm::OptimizeDeadCode);
+    const auto program = compiler.CompileString(entries);
+    ok = Expect(program->Size() < 8, "压缩后的程序长度") && ok;
+    for (const char *name : {"main", "entry", "done"}) {
+        ok = Expect(program->FindTable(name) >= 0 && program->FindTable(name) <= program->Size(),
+                    std::string("压缩后保留表 ") + name) && ok;
+    }
+    const auto &[code, Args] = program->GetInstructions()[program->FindTable("entry")];
+    ok = Expect(code == VMAsm::OpCode::MOV && Args[0].to<long>() == 7, "表 entry 仍指向 mov 7, R7") && ok;
+
+    // 寄存器间接跳转的目标无法静态得知, 整个程序保持原样
+    const std::string indirect = "main:\n mov 4, R1\n add 2, 3, R4\n mov 1, R2\n jmp R1\n mov 5, R2\n halt\n"
+                                 " mov 6, R2\n";
+    ok = CheckLevels("间接跳转", indirect) && ok;
+    const RunResult original = RunAt(indirect, VMAsm::OptimizeNone);
+    const RunResult unchanged = RunAt(indirect, VMAsm::OptimizeDeadCode);
+    ok = Expect(unchanged.size == original.size && unchanged.stats.folded == 0 && unchanged.stats.removed == 0 &&
+                unchanged.instructions == original.instructions, "含间接跳转的程序不被改写") && ok;
+    return ok;
+}
+
+static bool CheckJumpThreading() {
+    // 标签 loop 让 R1 的值在分支处未知, 分支不会被常量折叠
+    const std::string chain = "main:\n mov 1, R1\nloop:\n jnz R1, #a\n halt\na:\n jmp #b\nb:\n jmp #c\n"
+                              "c:\n mov 2, R2\n halt\n";
+    bool ok = CheckLevels("跳转链", chain);
+    const RunResult threaded = RunAt(chain, VMAsm::OptimizeDeadCode);
+    const RunResult original = RunAt(chain, VMAsm::OptimizeNone);
+    // 串联后 a 与 b 只剩标签引用, 作为不可达代码删除
+    ok = Expect(threaded.stats.threaded == 2 && threaded.stats.unreachable == 2 && threaded.size == 5,
+                "跳转链的串联计数") && ok;
+    ok = Expect(threaded.instructions < original.instructions, "串联后执行的指令更少") && ok;
+
+    const std::string over = "main:\n mov 1, R1\nx:\n jz R1, #skip\n jmp #end\nskip:\n mov 2, R2\nend:\n halt\n";
+    ok = CheckLevels("越过无条件跳转", over) && ok;
+    const RunResult inverted = RunAt(over, VMAsm::OptimizeDeadCode);
+    ok = Expect(inverted.stats.inverted == 1 && inverted.size == 4, "条件取反计数") && ok;
+
+    // 被越过的 jmp 带有标签时可能从外部进入, 不能取反
+    const std::string labeled = "main:\n mov 1, R1\nx:\n jz R1, #a\nb:\n jmp #c\na:\n mov 2, R2\nc:\n halt\n";
+    ok = CheckLevels("带标签的 jmp", labeled) && CheckLevels("从 b 进入", labeled, "b") && ok;
+    ok = Expect(RunAt(labeled, VMAsm::OptimizeDeadCode).stats.inverted == 0, "带标签的 jmp 不取反") && ok;
+
+    // 跳转环不能让串联陷入死循环; 程序本身不会结束, 只检查编译结果
+    VMAsm::Compiler compiler;
+    compiler.SetOptimizationLevel(VMAsm::OptimizeDeadCode);
+    const auto cycle = compiler.CompileString("main:\n jmp #a\na:\n jmp #b\nb:\n jmp #a\n");
+    const auto &last = cycle->GetInstructions().back();
+    ok = Expect(last.code == VMAsm::OpCode::JMP && last.Args[0].to<long>() < cycle->Size(), "跳转环保持为环") && ok;
+    return ok;
+}
+
+static size_t PeepholeHits(const VMAsm::OptimizerStats &stats, const std::string &rule) {
+    for (const auto &[name, hits] : stats.peephole) {
+        if (name == rule) return hits;
+    }
+    return 0;
+}
+
+static bool CheckPeephole() {
+    using VMAsm::Instruction;
+    using VMAsm::OpCode;
+
+    const std::string loop = "main:\n mov 100, R1\nloop:\n mov R3, R3\n add R2, R1, R2\n sub R1, 1, R1\n"
+                             " mov R2, R4\n jnz R1, #loop\n sub R5, R5, R6\n jz R6, #done\n mov 7, R7\ndone:\n halt\n";
+    bool ok = CheckLevels("窥孔规则", loop);
+    const RunResult rewritten = RunAt(loop, VMAsm::OptimizeConstants);
+    ok = Expect(PeepholeHits(rewritten.stats, "mov-self") == 1 && PeepholeHits(rewritten.stats, "sub-self-jz") == 1 &&
+                PeepholeHits(rewritten.stats, "sub-jnz-adjacent") == 1 && rewritten.size == 9, "内置规则的命中次数") && ok;
+    ok = Expect(rewritten.instructions < RunAt(loop, VMAsm::OptimizeNone).instructions, "改写后执行的指令更少") && ok;
+
+    // 自定义规则: 对同一寄存器连续取反两次等于不变
+    VMAsm::Compiler compiler;
+    compiler.SetOptimizationLevel(VMAsm::OptimizeConstants);
+    compiler.AddPeepholeRule({"double-neg", {OpCode::NEG, OpCode::NEG},
+        [](const std::vector<Instruction> &window, std::vector<Instruction> &) {
+            const auto &first = window[0].Args;
+            const auto &second = window[1].Args;
+            return first[0].is_reg && first[0].data == first[1].data &&
+                   second[0].is_reg && second[0].data == second[1].data && second[0].data == first[0].data;
+        }});
+    ok = Expect(compiler.CompileString("main:\n mov 5, R1\nx:\n neg R1, R1\n neg R1, R1\n halt\n")->Size() == 2 &&
+                compiler.GetOptimizerStats().peephole.back().hits == 1, "自定义规则生效") && ok;
+    // 窗口不跨越标签
+    ok = Expect(compiler.CompileString("main:\n mov 5, R1\n neg R1, R1\nx:\n neg R1, R1\n halt\n")->Size() == 4,
+                "窗口不跨越标签") && ok;
+
+    // 原样返回窗口不算命中
+    VMAsm::Compiler same;
+    same.SetOptimizationLevel(VMAsm::OptimizeConstants);
+    same.AddPeepholeRule({"same", {OpCode::MOV},
+        [](const std::vector<Instruction> &window, std::vector<Instruction> &replacement) {
+            replacement = window;
+            return true;
+        }});
+    ok = Expect(same.CompileString("mov 1, R1\nhalt\n")->Size() == 2 && same.GetOptimizerStats().peephole.back().hits == 0,
+                "原样返回窗口不算命中") && ok;
+
+    // 反复改写无法收敛时报错而不是死循环
+    VMAsm::Compiler flip;
+    flip.SetOptimizationLevel(VMAsm::OptimizeConstants);
+    flip.AddPeepholeRule({"flip", {OpCode::MOV},
+        [](const std::vector<Instruction> &window, std::vector<Instruction> &replacement) {
+            replacement = window;
+            replacement[0].Args[0].write(1 - window[0].Args[0].to<long>());
+            return true;
+        }});
+    ok = ExpectCompileError(flip, "mov 1, R1\nhalt\n", "flip") && ok;
+
+    // 规则输出非法的指令时报错
+    VMAsm::Compiler broken;
+    broken.SetOptimizationLevel(VMAsm::OptimizeConstants);
+    broken.AddPeepholeRule({"broken", {OpCode::HALT},
+        [](const std::vector<Instruction> &, std::vector<Instruction> &replacement) {
+            replacement = {{OpCode::ADD, {}}};
+            return true;
+        }});
+    ok = ExpectCompileError(broken, "halt\n", "Peephole rule broken") && ok;
+    return ok;
+}
+
+static std::vector<uint8_t> Bytes(const std::string &text) {
+    return {text.begin(), text.end()};
+}
+
+static bool CheckLexer() {
+    // 块注释可以跨行, 也可以紧贴 token
+    const RunResult comments = RunAt("main:\n mov 1, R1/* glued */\n/* spans\n mov 9, R9\n lines */ mov 2, R2//tail\n"
+                                     " mov 3, R3 /* a */ // b\r\n halt\r\n", VMAsm::OptimizeNone);
+    bool ok = Expect(comments.status == VMAsm::StatusHalt && RegisterLong(comments, 1) == 1 &&
+                     RegisterLong(comments, 2) == 2 && RegisterLong(comments, 3) == 3 && comments.registers[9].empty(),
+                     "注释与 CRLF");
+
+    // 字符串中的分号、井号、注释标记与逗号都是普通字符
+    const RunResult strings = RunAt("main:\n mov \"a;b#c//d/*e\\\"f\\\\g\\n\", R4\n mov \"x, y\", R5\n halt\n",
+                                    VMAsm::OptimizeNone);
+    ok = Expect(strings.registers[4] == Bytes(std::string("a;b#c//d/*e\"f\\g\n") + '\0'), "字符串转义") && ok;
+    ok = Expect(strings.registers[5] == Bytes(std::string("x, y") + '\0'), "字符串中的逗号") && ok;
+
+    const RunResult arrays = RunAt("main:\n mov [0x01, 2,0XfF , 10], R6\n mov [ ], R7\n mov 2.5, R8\n halt\n",
+                                   VMAsm::OptimizeNone);
+    ok = Expect(arrays.registers[6] == std::vector<uint8_t>{0x01, 0x02, 0xff, 0x10} && arrays.registers[7].empty(),
+                "字节数组") && ok;
+    VMAsm::Value real;
+    real.data = arrays.registers[8];
+    ok = Expect(real.to<double>() == 2.5, "浮点数") && ok;
+
+    // 助记符经完美哈希查找, 不区分大小写; 哈希槽位相同的其他单词仍然是未知指令
+    const RunResult mnemonics = RunAt("MAIN:\n MoV 5, r6\n SNAP_push\n Snap_Pop\n hAlT\n", VMAsm::OptimizeNone);
+    ok = Expect(mnemonics.status == VMAsm::StatusHalt && RegisterLong(mnemonics, 6) == 5, "大小写混合的助记符") && ok;
+
+    // 整数按十进制解析, 十六进制只用于字节数组; 十六进制写法作为普通字符串保留
+    const RunResult integers = RunAt("main:\n mov -42, R1\n mov +7, R2\n mov -9223372036854775808, R3\n"
+                                     " mov 0x10, R4\n halt\n", VMAsm::OptimizeNone);
+    ok = Expect(RegisterLong(integers, 1) == -42 && RegisterLong(integers, 2) == 7 &&
+                RegisterLong(integers, 3) == std::numeric_limits<long>::min() &&
+                integers.registers[4] == Bytes(std::string("0x10") + '\0'), "整数") && ok;
+
+    VMAsm::Compiler compiler;
+    ok = ExpectCompileError(compiler, "main:\n mov 9223372036854775808, R1\n", "Invalid integer") && ok;
+    ok = ExpectCompileError(compiler, "main:\n mov 1, R64\n", "Register index out of range") && ok;
+    ok = ExpectCompileError(compiler, "main:\n mov 1, R256\n", "Register index out of range") && ok;
+    ok = ExpectCompileError(compiler, "main:\n jmp #nowhere_label\n", "Undefined table: nowhere_label") && ok;
+    ok = ExpectCompileError(compiler, "main:\n nap\n", "Unknown opcodes:nap") && ok;
+    ok = ExpectCompileError(compiler, "main:\n mov [0x100], R1\n", "Byte value out of range") && ok;
+    ok = ExpectCompileError(compiler, "main:\n mov [zz], R1\n", "Invalid byte format") && ok;
+    ok = ExpectCompileError(compiler, "main:\n mov \"a\\q\", R1\n", "Invalid escape sequence") && ok;
+    ok = ExpectCompileError(compiler, "#table a b\nmain:\n halt\n", "Invalid table definition syntax") && ok;
+    return ok;
+}
+
+int main(int argc, char *argv[]) {
+    const std::filesystem::path path = VMASM_TEST_DIR;
 
     VMAsm::VirtualMachine vm;
     VMAsm::Compiler compiler;
@@ -46,7 +933,7 @@ int main(int argc, char *argv[]) {
     VMAsm::SysCallRegistry::Init(&vm);
 
     if (compiler.Compile({
-        "/home/yuwu/CLionProjects/Vmasm/test/test.vmasm",
+        (path / "test.vmasm").string(),
     }, &vm)) {
         std::cout << "编译成功!" << std::endl;
         vm.Execute(); // 从main标签开始执行
@@ -60,6 +947,47 @@ int main(int argc, char *argv[]) {
     std::cout << "Disassembled code:\n";
     std::cout << asmCode << std::endl;
 
+    bool jit = true;
+    for (const char *name : {"test.vmasm", "jit.vmasm"}) {
+        jit = CheckJit((path / name).string()) && jit;
+    }
+    std::cout << (jit ? "JIT 与解释器结果一致" : "JIT 与解释器结果不一致") << std::endl;
 
-    return 0;
-}
\ No newline at end of file
+    const std::pair<const char *, bool (*)()> checks[] = {
+        {"分派方式", CheckDispatch},
+        {"旧版字节码", CheckLegacyBytecode},
+        {"超级指令", CheckFusion},
+        {"寄存器快照", CheckSnapshots},
+        {"共享程序", CheckSharedProgram},
+        {"并行执行", CheckExecutor},
+        {"指令预算", CheckBudgets},
+        {"异步系统调用", CheckSuspend},
+        {"系统调用参数", CheckSyscallArity},
+        {"缓冲输出", CheckOutput},
+        {"执行剖析", CheckProfile},
+        {"采样剖析", CheckSampling},
+        {"执行跟踪", CheckTrace},
+        {"字节码校验", CheckVerifier},
+        {"字节码加载", CheckBytecodeLoading},
+        {"常量折叠", CheckConstantFolding},
+        {"死代码删除", CheckDeadCode},
+        {"跳转串联", CheckJumpThreading},
+        {"窥孔规则", CheckPeephole},
+        {"词法分析", CheckLexer},
+    };
+    bool ok = jit;
+    for (const auto &[name, check] : checks) {
+        bool passed;
+        try {
+            passed = check();
+        } catch (const std::exception &e) {
+            std::cerr << name << " 抛出异常: " << e.what() << std::endl;
+            passed = false;
+        }
+        std::cout << name << (passed ? ": 通过" : ": 失败") << std::endl;
+        ok = passed && ok;
+    }
+    std::cout << (ok ? "全部测试通过" : "存在失败的测试") << std::endl;
+
+    return ok ? 0 : 1;
+}